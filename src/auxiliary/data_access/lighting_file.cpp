@@ -0,0 +1,149 @@
+/*
+ * 2021 Tarpeeksi Hyvae Soft
+ *
+ * Software: Vond
+ *
+ * Caches baked terrain lighting maps on disk, so that they needn't be re-baked
+ * each time the program starts.
+ *
+ * The cache file consists of a header - the magic bytes "VLT2", the map's width
+ * and height as 32-bit integers, a 64-bit hash of the heightmap the map was baked
+ * from (including its bounds-checking mode, which affects the lighting at the
+ * map's edges), and the bake parameters (the number of AO directions and the AO
+ * search distance as 32-bit integers, and the height scale as a double) -
+ * followed by the map's RGBA pixels.
+ *
+ */
+
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include "auxiliary/data_access/lighting_file.h"
+#include "vond/terrain_lighting.h"
+
+static const char CACHE_MAGIC[4] = {'V', 'L', 'T', '2'};
+
+// Returns a hash of the given heightmap's contents, for detecting whether a cached
+// lighting map is out of date (FNV-1a).
+static uint64_t heightmap_hash(const vond::image<double, 1> &heightmap)
+{
+    uint64_t hash = 14695981039346656037ull;
+
+    hash = ((hash ^ uint8_t(heightmap.boundsCheckingMode)) * 1099511628211ull);
+
+    for (unsigned y = 0; y < heightmap.height(); y++)
+    {
+        for (unsigned x = 0; x < heightmap.width(); x++)
+        {
+            const double height = heightmap.pixel_at(x, y)[0];
+            const uint8_t *const bytes = (const uint8_t*)&height;
+
+            for (unsigned i = 0; i < sizeof(height); i++)
+            {
+                hash = ((hash ^ bytes[i]) * 1099511628211ull);
+            }
+        }
+    }
+
+    return hash;
+}
+
+// Loads into the given lighting map the cached lighting map in the given file.
+// Returns true on success; false if the file doesn't exist or doesn't match the
+// given heightmap hash, bake parameters, or lighting map dimensions.
+static bool load_cached(const char *const cacheFilename,
+                        const uint64_t heightmapHash,
+                        const vond::terrain_lighting_params &params,
+                        vond::image<uint8_t, 4> &lightingMap)
+{
+    std::ifstream file(cacheFilename, std::ios::binary);
+
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    char magic[4] = {0};
+    uint32_t width = 0, height = 0;
+    uint64_t hash = 0;
+    uint32_t aoNumDirections = 0, aoSearchDistance = 0;
+    double heightScale = 0;
+
+    file.read(magic, sizeof(magic));
+    file.read((char*)&width, sizeof(width));
+    file.read((char*)&height, sizeof(height));
+    file.read((char*)&hash, sizeof(hash));
+    file.read((char*)&aoNumDirections, sizeof(aoNumDirections));
+    file.read((char*)&aoSearchDistance, sizeof(aoSearchDistance));
+    file.read((char*)&heightScale, sizeof(heightScale));
+
+    if (!file ||
+        memcmp(magic, CACHE_MAGIC, sizeof(magic)) ||
+        (width != lightingMap.width()) ||
+        (height != lightingMap.height()) ||
+        (hash != heightmapHash) ||
+        (aoNumDirections != params.aoNumDirections) ||
+        (aoSearchDistance != params.aoSearchDistance) ||
+        (heightScale != params.heightScale))
+    {
+        return false;
+    }
+
+    file.read((char*)&lightingMap.pixel_at(0, 0), (std::streamsize(width) * height * 4));
+
+    return bool(file);
+}
+
+static void save_cached(const char *const cacheFilename,
+                        const uint64_t heightmapHash,
+                        const vond::terrain_lighting_params &params,
+                        const vond::image<uint8_t, 4> &lightingMap)
+{
+    std::ofstream file(cacheFilename, std::ios::binary);
+
+    if (!file.is_open())
+    {
+        fprintf(stderr, "Failed to open '%s' for caching the terrain lighting map.\n", cacheFilename);
+        return;
+    }
+
+    const uint32_t width = lightingMap.width();
+    const uint32_t height = lightingMap.height();
+    const uint32_t aoNumDirections = params.aoNumDirections;
+    const uint32_t aoSearchDistance = params.aoSearchDistance;
+
+    file.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    file.write((const char*)&width, sizeof(width));
+    file.write((const char*)&height, sizeof(height));
+    file.write((const char*)&heightmapHash, sizeof(heightmapHash));
+    file.write((const char*)&aoNumDirections, sizeof(aoNumDirections));
+    file.write((const char*)&aoSearchDistance, sizeof(aoSearchDistance));
+    file.write((const char*)&params.heightScale, sizeof(params.heightScale));
+    file.write((const char*)lightingMap.pixel_array(), (std::streamsize(width) * height * 4));
+
+    return;
+}
+
+// Returns a lighting map (see vond::bake_terrain_lighting()) for the given
+// heightmap, baked with the given parameters. If the given cache file holds an
+// up-to-date lighting map, it's loaded from there; otherwise, the map is baked
+// and then saved into the cache file.
+//
+vond::image<uint8_t, 4> klighting_terrain_lighting(const char *const cacheFilename,
+                                                   const vond::image<double, 1> &heightmap,
+                                                   const vond::terrain_lighting_params &params)
+{
+    const uint64_t hash = heightmap_hash(heightmap);
+
+    vond::image<uint8_t, 4> lightingMap(heightmap.width(), heightmap.height(), 32);
+
+    if (!load_cached(cacheFilename, hash, params, lightingMap))
+    {
+        printf("Baking the terrain lighting map...\n");
+
+        vond::bake_terrain_lighting(heightmap, lightingMap, params);
+        save_cached(cacheFilename, hash, params, lightingMap);
+    }
+
+    return lightingMap;
+}
@@ -0,0 +1,18 @@
+/*
+ * 2021 Tarpeeksi Hyvae Soft
+ *
+ * Software: Vond
+ *
+ */
+
+#ifndef DATA_ACCESS_LIGHTING_FILE_H
+#define DATA_ACCESS_LIGHTING_FILE_H
+
+#include "vond/image.h"
+#include "vond/terrain_lighting.h"
+
+vond::image<uint8_t, 4> klighting_terrain_lighting(const char *const cacheFilename,
+                                                   const vond::image<double, 1> &heightmap,
+                                                   const vond::terrain_lighting_params &params = {});
+
+#endif
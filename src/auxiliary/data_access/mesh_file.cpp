@@ -8,21 +8,29 @@
  */
 
 #include <unordered_map>
+#include <tuple>
+#include <map>
 #include <fstream>
 #include <vector>
 #include <regex>
 #include "auxiliary/data_access/mesh_file.h"
 #include "auxiliary/config_file_read.h"
 #include "vond/triangle.h"
+#include "vond/mesh.h"
 
-// Returns the triangles stored in the given mesh config file.
+// Returns the mesh stored in the given mesh config file.
 //
-std::vector<vond::triangle> kmesh_mesh_triangles(const char *const meshFilename)
+vond::mesh kmesh_mesh(const char *const meshFilename)
 {
     config_file_read_c meshFile(meshFilename);
 
-    std::vector<vond::triangle> meshTriangles;
-    std::unordered_map<std::string/*material name*/, vond::triangle_material> knownMaterials;
+    vond::mesh mesh;
+    std::unordered_map<std::string/*material name*/, uint16_t/*index in the material table*/> knownMaterials;
+
+    // The mesh's vertices so far, for welding duplicates: vertices with identical
+    // position and u,v coordinates are stored only once, and shared among the
+    // triangles that use them.
+    std::map<std::tuple<double, double, double, double, double>/*position, u,v*/, uint32_t/*index in the vertex buffer*/> knownVertices;
 
     // Parse the mesh file to extract the materials and meshes in it.
     config_file_line_s line = meshFile.next_line();
@@ -80,7 +88,12 @@ std::vector<vond::triangle> kmesh_mesh_triangles(const char *const meshFilename)
                     {
                         //add_to_known_materials({materialName, material});
 
-                        knownMaterials.insert({materialName, material});
+                        // Triangles refer to their material by a 16-bit index.
+                        const std::size_t materialIdx = mesh.materials.size();
+                        meshFile.error_if_not((materialIdx <= std::numeric_limits<uint16_t>::max()), "Too many materials; a mesh can have at most 65536.");
+
+                        knownMaterials.insert({materialName, uint16_t(materialIdx)});
+                        mesh.materials.push_back(material);
 
                         break;
                     }
@@ -100,9 +113,19 @@ std::vector<vond::triangle> kmesh_mesh_triangles(const char *const meshFilename)
                         case 't':       // Texture.
                         {
                             meshFile.error_if_not(!material.texture, "Can't re-define the texture for a material.");
-                            meshFile.error_if_not((line.params.size() == 1), "Expected one parameters for the material's texture filename.");
+                            meshFile.error_if_not(((line.params.size() == 1) || (line.params.size() == 2)), "Expected one or two parameters for the material's texture: its filename and, optionally, its layout.");
 
-                            material.texture = new vond::image<uint8_t, 4>(QImage(QString::fromStdString(line.params.at(0))));
+                            // The texels' layout in memory; "linear" (the default) or "tiled".
+                            // See vond::texture_layout_e.
+                            vond::texture_layout_e layout = vond::texture_layout_e::linear;
+                            if (line.params.size() == 2)
+                            {
+                                meshFile.error_if_not(((line.params.at(1) == "linear") || (line.params.at(1) == "tiled")), "Unrecognized texture layout; expected \"linear\" or \"tiled\".");
+
+                                layout = ((line.params.at(1) == "tiled")? vond::texture_layout_e::tiled : vond::texture_layout_e::linear);
+                            }
+
+                            material.texture = new vond::texture(QImage(QString::fromStdString(line.params.at(0))), layout);
 
                             break;
                         }
@@ -120,7 +143,6 @@ std::vector<vond::triangle> kmesh_mesh_triangles(const char *const meshFilename)
             case 'o':       // Object.
             {
                 // Get all polygons (for now, we assume they're all triangles).
-                std::vector<vond::triangle> triangles;
                 line = meshFile.next_line();
                 while (!meshFile.file_is_at_end() &&
                        line.command == 'p' &&
@@ -131,8 +153,7 @@ std::vector<vond::triangle> kmesh_mesh_triangles(const char *const meshFilename)
                     meshFile.error_if_not(line.params.size() == 1, "Expected the polygon line to have one parameter.");
 
                     /// For now, assume we always have triangles rathern than other types of polygons.
-                    vond::triangle tri;
-                    vond::triangle_material material = knownMaterials.at(line.params.at(0));
+                    const uint16_t materialIdx = knownMaterials.at(line.params.at(0));
 
                     // Get all vertices of this polygon.
                     std::vector<vond::vertex> vertices;
@@ -190,17 +211,27 @@ std::vector<vond::triangle> kmesh_mesh_triangles(const char *const meshFilename)
                     {
                         meshFile.error_if_not((vertices.size() == 3), "Encountered a non-triangle polygon. They're not supported.");
 
-                        tri.v[0] = vertices.at(0);
-                        tri.v[1] = vertices.at(1);
-                        tri.v[2] = vertices.at(2);
-                        tri.material = material;
+                        for (const vond::vertex &vert: vertices)
+                        {
+                            const auto vertexKey = std::make_tuple(vert.position[0], vert.position[1], vert.position[2], vert.uv[0], vert.uv[1]);
+                            const auto [knownVertex, isNewVertex] = knownVertices.insert({vertexKey, mesh.num_vertices()});
+
+                            if (isNewVertex)
+                            {
+                                mesh.x.push_back(vert.position[0]);
+                                mesh.y.push_back(vert.position[1]);
+                                mesh.z.push_back(vert.position[2]);
+                                mesh.u.push_back(vert.uv[0]);
+                                mesh.v.push_back(vert.uv[1]);
+                            }
 
-                        triangles.push_back(tri);
+                            mesh.indices.push_back(knownVertex->second);
+                        }
+
+                        mesh.materialIndices.push_back(materialIdx);
                     }
                 }
 
-                meshTriangles.insert(meshTriangles.end(), triangles.begin(), triangles.end());
-
                 break;
             }
 
@@ -211,5 +242,7 @@ std::vector<vond::triangle> kmesh_mesh_triangles(const char *const meshFilename)
         }
     }
 
-    return meshTriangles;
+    mesh.update_bounding_sphere();
+
+    return mesh;
 }
@@ -7,8 +7,8 @@
 #ifndef DATA_ACCESS_MESH_FILE_H
 #define DATA_ACCESS_MESH_FILE_H
 
-#include "vond/triangle.h"
+#include "vond/mesh.h"
 
-std::vector<vond::triangle> kmesh_mesh_triangles(const char *const meshFilename);
+vond::mesh kmesh_mesh(const char *const meshFilename);
 
 #endif
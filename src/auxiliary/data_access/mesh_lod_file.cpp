@@ -0,0 +1,214 @@
+/*
+ * 2021 Tarpeeksi Hyvae Soft
+ *
+ * Software: Vond
+ *
+ * Caches meshes' generated levels of detail on disk, so that they needn't be
+ * regenerated each time the program starts.
+ *
+ * The cache file consists of a header - the magic bytes "VLOD", a 64-bit hash of
+ * the mesh the levels of detail were generated from, and the number of levels as
+ * a 32-bit integer - followed by each level: its error as a double, its numbers of
+ * vertices and triangles as 32-bit integers, its vertex arrays (x, y, z, u, v) as
+ * doubles, its index buffer, and its triangles' material indices. The materials
+ * and bounding sphere are those of the original mesh, so aren't stored.
+ *
+ */
+
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include "auxiliary/data_access/mesh_lod_file.h"
+#include "vond/mesh_simplify.h"
+
+static const char CACHE_MAGIC[4] = {'V', 'L', 'O', 'D'};
+
+template <typename T>
+static void hash_array(uint64_t &hash, const std::vector<T> &array)
+{
+    const uint8_t *const bytes = (const uint8_t*)array.data();
+
+    for (std::size_t i = 0; i < (array.size() * sizeof(T)); i++)
+    {
+        hash = ((hash ^ bytes[i]) * 1099511628211ull);
+    }
+
+    return;
+}
+
+// Returns a hash of the given mesh's geometry, for detecting whether cached levels
+// of detail are out of date (FNV-1a).
+static uint64_t mesh_hash(const vond::mesh &mesh)
+{
+    uint64_t hash = 14695981039346656037ull;
+
+    hash_array(hash, mesh.x);
+    hash_array(hash, mesh.y);
+    hash_array(hash, mesh.z);
+    hash_array(hash, mesh.u);
+    hash_array(hash, mesh.v);
+    hash_array(hash, mesh.indices);
+    hash_array(hash, mesh.materialIndices);
+
+    return hash;
+}
+
+template <typename T>
+static void read_array(std::ifstream &file, std::vector<T> &array, const uint32_t count)
+{
+    array.resize(count);
+    file.read((char*)array.data(), (std::streamsize(count) * sizeof(T)));
+
+    return;
+}
+
+template <typename T>
+static void write_array(std::ofstream &file, const std::vector<T> &array)
+{
+    file.write((const char*)array.data(), (std::streamsize(array.size()) * sizeof(T)));
+
+    return;
+}
+
+// Loads into the given vector the cached levels of detail in the given file.
+// Returns true on success; false if the file doesn't exist or doesn't match the
+// given mesh.
+static bool load_cached(const char *const cacheFilename,
+                        const vond::mesh &mesh,
+                        std::vector<vond::mesh> &lods)
+{
+    std::ifstream file(cacheFilename, std::ios::binary);
+
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    char magic[4] = {0};
+    uint64_t hash = 0;
+    uint32_t numLods = 0;
+
+    file.read(magic, sizeof(magic));
+    file.read((char*)&hash, sizeof(hash));
+    file.read((char*)&numLods, sizeof(numLods));
+
+    if (!file ||
+        memcmp(magic, CACHE_MAGIC, sizeof(magic)) ||
+        (hash != mesh_hash(mesh)))
+    {
+        return false;
+    }
+
+    lods.resize(numLods);
+
+    for (vond::mesh &lod: lods)
+    {
+        uint32_t numVertices = 0, numTriangles = 0;
+
+        file.read((char*)&lod.lodError, sizeof(lod.lodError));
+        file.read((char*)&numVertices, sizeof(numVertices));
+        file.read((char*)&numTriangles, sizeof(numTriangles));
+
+        if (!file ||
+            (numVertices > mesh.num_vertices()) ||
+            (numTriangles > mesh.num_triangles()))
+        {
+            return false;
+        }
+
+        read_array(file, lod.x, numVertices);
+        read_array(file, lod.y, numVertices);
+        read_array(file, lod.z, numVertices);
+        read_array(file, lod.u, numVertices);
+        read_array(file, lod.v, numVertices);
+        read_array(file, lod.indices, (numTriangles * 3));
+        read_array(file, lod.materialIndices, numTriangles);
+
+        if (!file)
+        {
+            return false;
+        }
+
+        for (unsigned i = 0; i < lod.indices.size(); i++)
+        {
+            if (lod.indices[i] >= numVertices)
+            {
+                return false;
+            }
+        }
+
+        for (unsigned i = 0; i < lod.materialIndices.size(); i++)
+        {
+            if (lod.materialIndices[i] >= mesh.materials.size())
+            {
+                return false;
+            }
+        }
+
+        lod.materials = mesh.materials;
+        lod.boundingCenter = mesh.boundingCenter;
+        lod.boundingRadius = mesh.boundingRadius;
+    }
+
+    return true;
+}
+
+static void save_cached(const char *const cacheFilename,
+                        const vond::mesh &mesh,
+                        const std::vector<vond::mesh> &lods)
+{
+    std::ofstream file(cacheFilename, std::ios::binary);
+
+    if (!file.is_open())
+    {
+        fprintf(stderr, "Failed to open '%s' for caching the mesh's levels of detail.\n", cacheFilename);
+        return;
+    }
+
+    const uint64_t hash = mesh_hash(mesh);
+    const uint32_t numLods = lods.size();
+
+    file.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    file.write((const char*)&hash, sizeof(hash));
+    file.write((const char*)&numLods, sizeof(numLods));
+
+    for (const vond::mesh &lod: lods)
+    {
+        const uint32_t numVertices = lod.num_vertices();
+        const uint32_t numTriangles = lod.num_triangles();
+
+        file.write((const char*)&lod.lodError, sizeof(lod.lodError));
+        file.write((const char*)&numVertices, sizeof(numVertices));
+        file.write((const char*)&numTriangles, sizeof(numTriangles));
+
+        write_array(file, lod.x);
+        write_array(file, lod.y);
+        write_array(file, lod.z);
+        write_array(file, lod.u);
+        write_array(file, lod.v);
+        write_array(file, lod.indices);
+        write_array(file, lod.materialIndices);
+    }
+
+    return;
+}
+
+// Returns levels of detail (see vond::generate_lods()) for the given mesh. If the
+// given cache file holds up-to-date levels of detail, they're loaded from there;
+// otherwise, they're generated and then saved into the cache file.
+//
+std::vector<vond::mesh> kmesh_lods(const char *const cacheFilename,
+                                   const vond::mesh &mesh)
+{
+    std::vector<vond::mesh> lods;
+
+    if (!load_cached(cacheFilename, mesh, lods))
+    {
+        printf("Generating the mesh's levels of detail...\n");
+
+        lods = vond::generate_lods(mesh);
+        save_cached(cacheFilename, mesh, lods);
+    }
+
+    return lods;
+}
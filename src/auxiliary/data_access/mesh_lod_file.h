@@ -0,0 +1,17 @@
+/*
+ * 2021 Tarpeeksi Hyvae Soft
+ *
+ * Software: Vond
+ *
+ */
+
+#ifndef DATA_ACCESS_MESH_LOD_FILE_H
+#define DATA_ACCESS_MESH_LOD_FILE_H
+
+#include <vector>
+#include "vond/mesh.h"
+
+std::vector<vond::mesh> kmesh_lods(const char *const cacheFilename,
+                                   const vond::mesh &mesh);
+
+#endif
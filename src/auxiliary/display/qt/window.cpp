@@ -99,6 +99,7 @@ bool Window::eventFilter(QObject *, QEvent *event)
             case Qt::Key_D: { kinput_move_camera_backward(true); break; }
             case Qt::Key_S: { kinput_move_camera_left(true); break; }
             case Qt::Key_F: { kinput_move_camera_right(true); break; }
+            case Qt::Key_T: { if (!e->isAutoRepeat()) kinput_toggle_triangle_sorting(); break; }
             default: break;
         }
 
@@ -11,23 +11,49 @@
 
 #include <QElapsedTimer>
 #include <iostream>
+#include <cstdio>
 #include <thread>
 #include <chrono>
 #include <deque>
+#include <random>
 #include "auxiliary/config_file_read.h"
+#include "auxiliary/data_access/lighting_file.h"
+#include "auxiliary/data_access/mesh_lod_file.h"
 #include "auxiliary/display.h"
 #include "vond/render_landscape.h"
 #include "vond/render_triangles.h"
+#include "vond/instance_quadtree.h"
 #include "vond/assert.h"
 #include "vond/camera.h"
 #include "vond/image.h"
 #include "vond/image_mosaic.h"
+#include "vond/horizon_map.h"
+#include "vond/terrain_lighting.h"
+#include "vond/landscape_impostor.h"
+#include "vond/fog.h"
+#include "vond/depth_pyramid.h"
 #include "auxiliary/ui.h"
 #include "auxiliary/ui/input.h"
 
 // Set to !0 when the user wants to exit the program.
 static int PROGRAM_EXIT_REQUESTED = 0;
 
+// Whether to render the landscape before the triangles, rather than after.
+static const bool IS_LANDSCAPE_DRAWN_FIRST = true;
+
+// Whether to initially sort the triangles front to back before drawing them. The
+// user can toggle the sorting at run-time (T key).
+static const bool IS_TRIANGLE_ORDER_SORTED = true;
+
+// The rasterizer to draw the triangles with. By default, each triangle is drawn
+// with the rasterizer that's cheapest for its size on screen.
+static const vond::triangle_rasterizer_e TRIANGLE_RASTERIZER = vond::triangle_rasterizer_e::automatic;
+
+// Whether the landscape repeats infinitely in every direction, rather than ending
+// at the heightmap's edges. Its heightmap and texture must then have power-of-two
+// dimensions.
+static const bool IS_LANDSCAPE_TILED = false;
+
 static void init_system(void)
 {
     printf("Initializing the program...\n");
@@ -83,35 +109,82 @@ int main(void)
         vond::image<uint8_t, 4> renderBuffer(480, 300, 32);
         vond::image<double, 1> depthMap(renderBuffer.width(), renderBuffer.height(), renderBuffer.bpp());
 
+        // Recycles the buffers of images made anew each frame, like debug views.
+        vond::image_buffer_pool frameImagePool;
+
         /// TODO: In the future, asset initialization will be handled somewhere other than here.
         vond::image<double, 1> landscapeHeightmap(QImage("height.png"));
         vond::image<uint8_t, 4> landscapeTexture(QImage("ground.png"));
-        std::vector<vond::triangle> model = kmesh_mesh_triangles("untitled.vmf");
+        vond::mesh model = kmesh_mesh("untitled.vmf");
+        model.lods = kmesh_lods("untitled_lods.cache", model);
+
+        if (IS_LANDSCAPE_TILED)
+        {
+            vond_assert(landscapeHeightmap.is_pow2(), "A tiling landscape's heightmap must have power-of-two dimensions.");
+            landscapeHeightmap.boundsCheckingMode = vond::image_bounds_checking_mode_e::wrapped_pow2;
+        }
 
         landscapeHeightmap.bilinear_filter(4);
 
-        const auto landscapeHeightmapSampler = [&landscapeHeightmap]
-        (const vond::vector3<double> &samplePosition, const vond::vector3<double> &viewerPosition)->vond::color_grayscale<double>
+        // Scatter instances of the model over the terrain.
+        std::vector<vond::mesh_instance> modelInstances;
         {
-            (void)viewerPosition;
+            vond::mesh_instance instance;
+            instance.mesh = &model;
+            instance.transform = vond::translation_matrix(512, 110, 512);
+            modelInstances.push_back(instance);
 
-            return landscapeHeightmap.pixel_at(samplePosition[0], samplePosition[2]);
-        };
+            std::mt19937 rng(1);
+            std::uniform_real_distribution<double> randomX(0, (landscapeHeightmap.width() - 1));
+            std::uniform_real_distribution<double> randomZ(0, (landscapeHeightmap.height() - 1));
+            std::uniform_real_distribution<double> randomScale(0.03, 0.1);
 
-        const auto landscapeTextureSampler = [&landscapeTexture]
-        (const vond::vector3<double> &samplePosition, const vond::vector3<double> &viewerPosition)->vond::color_rgba<uint8_t>
+            for (unsigned i = 0; i < 2000; i++)
+            {
+                const double x = randomX(rng);
+                const double z = randomZ(rng);
+                const double scale = randomScale(rng);
+                const double y = (landscapeHeightmap.bilinear_sample(x, z).channel_at(0) + (model.boundingRadius * scale));
+
+                instance.transform = (vond::translation_matrix(x, y, z) * vond::scaling_matrix(scale, scale, scale));
+                modelInstances.push_back(instance);
+            }
+        }
+
+        // A spatial index of the model instances, for finding those in view without
+        // testing each one.
+        vond::instance_quadtree modelInstanceTree(0, 0, std::max(landscapeHeightmap.width(), landscapeHeightmap.height()), 0, 256);
+        for (const vond::mesh_instance &instance: modelInstances)
+        {
+            modelInstanceTree.insert(&instance);
+        }
+        std::vector<const vond::mesh_instance*> visibleModelInstances;
+
+        // Precompute the terrain's horizons so that sun shadows can be looked up
+        // rather than traced.
+        const vond::vector3<double> sunDirection = {-1, 0.35, 0.6};
+        vond::horizon_map landscapeHorizons(landscapeHeightmap);
+        landscapeHorizons.set_sun_direction(sunDirection);
+        landscapeHorizons.update();
+
+        // Per-texel normals and ambient occlusion for lighting the terrain.
+        const vond::image<uint8_t, 4> landscapeLighting = klighting_terrain_lighting("terrain_lighting.cache", landscapeHeightmap);
+
+        const auto landscapeHeightmapSampler = [&landscapeHeightmap]
+        (const vond::vector3<double> &samplePosition, const vond::vector3<double> &viewerPosition)->vond::color_grayscale<double>
         {
             (void)viewerPosition;
 
-            if ((samplePosition[0] < 0) || (samplePosition[0] > landscapeTexture.width()) ||
-                (samplePosition[2] < 0) || (samplePosition[2] > landscapeTexture.height()))
-            {
-                return {0, 0, 0, 0};
-            }
+            const int x = int(std::floor(samplePosition[0]));
+            const int z = int(std::floor(samplePosition[2]));
 
-            return landscapeTexture.bilinear_sample(samplePosition[0], samplePosition[2]);
+            return (IS_LANDSCAPE_TILED
+                    ? landscapeHeightmap.pixel_at<vond::image_bounds_checking_mode_e::wrapped_pow2>(x, z)
+                    : landscapeHeightmap.pixel_at<vond::image_bounds_checking_mode_e::clamped>(x, z));
         };
 
+        const auto landscapeTextureSampler = vond::lit_texture_sampler(landscapeTexture, landscapeLighting, sunDirection, &landscapeHorizons, IS_LANDSCAPE_TILED);
+
         const auto landscapeSkySampler = [&]
         (const vond::vector3<double> &outDirection, const vond::vector3<double> &viewerPosition)->vond::color_rgb<uint8_t>
         {
@@ -136,6 +209,22 @@ int main(void)
         camera.zoom = 1;
         camera.fov = 70;
 
+        // Distance fog. Landscape rays stop where the fog becomes opaque.
+        const vond::fog landscapeFog(0.003, {100, 138, 171}, {120, 150, 190});
+
+        // Terrain farther away than the impostor's radius is drawn from the impostor.
+        vond::landscape_impostor landscapeFarField(300, landscapeFog.visibility_distance());
+        landscapeFarField.update(landscapeHeightmapSampler, landscapeTextureSampler, camera.position, landscapeFarField.num_columns());
+
+        // For rejecting triangles hidden behind the landscape.
+        vond::depth_pyramid depthPyramid;
+
+        bool isTriangleOrderSorted = IS_TRIANGLE_ORDER_SORTED;
+
+        // The triangle stats of the most recent frame drawn without and with
+        // sorting the triangles, for comparing the two modes' overdraw.
+        vond::triangle_raster_stats lastRasterStats[2];
+
         while (!PROGRAM_EXIT_REQUESTED)
         {
             static std::deque<uint> fps;
@@ -158,8 +247,71 @@ int main(void)
                 ktext_add_ui_text(std::string("FPS: ") + std::to_string(avgFPS), {10, 20});
                 kd_update_input(&camera);
 
-                vond::render_landscape(landscapeHeightmapSampler, landscapeTextureSampler, landscapeSkySampler, renderBuffer, depthMap, camera);
-                //vond::render_triangles(model, renderBuffer, depthMap, camera);
+                if (kinput_is_triangle_sorting_toggled())
+                {
+                    isTriangleOrderSorted = !isTriangleOrderSorted;
+                }
+
+                // If the camera has moved, spread the rebuilding of the far field
+                // over several frames. (The sun doesn't move, so its horizons were
+                // built once, above.)
+                landscapeFarField.update(landscapeHeightmapSampler, landscapeTextureSampler, camera.position, 64);
+
+                vond::triangle_raster_stats rasterStats;
+
+                visibleModelInstances.clear();
+                modelInstanceTree.query(vond::camera_frustum(camera, renderBuffer.width(), renderBuffer.height()), visibleModelInstances);
+
+                // Drawing the landscape first lets triangles hidden by the terrain
+                // be rejected early via a depth pyramid of the terrain. Drawing the
+                // triangles first instead lets the landscape's rays stop where the
+                // triangles occlude the terrain.
+                if (IS_LANDSCAPE_DRAWN_FIRST)
+                {
+                    vond::render_landscape(landscapeHeightmapSampler, landscapeTextureSampler, landscapeSkySampler, renderBuffer, depthMap, camera, &landscapeFarField, &landscapeFog);
+                    depthPyramid.build(depthMap);
+                    vond::render_triangles(visibleModelInstances, renderBuffer, depthMap, camera, &depthPyramid, &rasterStats, isTriangleOrderSorted, TRIANGLE_RASTERIZER);
+                }
+                else
+                {
+                    vond::render_triangles(visibleModelInstances, renderBuffer, depthMap, camera, nullptr, &rasterStats, isTriangleOrderSorted, TRIANGLE_RASTERIZER);
+                    vond::render_landscape(landscapeHeightmapSampler, landscapeTextureSampler, landscapeSkySampler, renderBuffer, depthMap, camera, &landscapeFarField, &landscapeFog);
+                }
+
+                ktext_add_ui_text(std::string("Tris (point/barycentric/half-space/scanline/occluded): ") + std::to_string(rasterStats.numPoint) +
+                                  "/" + std::to_string(rasterStats.numBarycentric) +
+                                  "/" + std::to_string(rasterStats.numHalfSpace) +
+                                  "/" + std::to_string(rasterStats.numScanline) +
+                                  "/" + std::to_string(rasterStats.numOccluded), {10, 40});
+                ktext_add_ui_text(std::string("Instances culled: ") + std::to_string(modelInstances.size() - visibleModelInstances.size() + rasterStats.numCulledInstances) +
+                                  "/" + std::to_string(modelInstances.size()), {10, 60});
+                ktext_add_ui_text(std::string("Pixels drawn/covered: ") + std::to_string(rasterStats.numPixelsDrawn) +
+                                  "/" + std::to_string(rasterStats.numPixelsCovered), {10, 80});
+
+                // The overdraw with and without sorting, each as of the most recent
+                // frame drawn in that mode.
+                {
+                    lastRasterStats[isTriangleOrderSorted] = rasterStats;
+
+                    const auto overdraw = [](const vond::triangle_raster_stats &stats)->std::string
+                    {
+                        if (!stats.numPixelsCovered)
+                        {
+                            return "-";
+                        }
+
+                        char ratio[16];
+                        snprintf(ratio, sizeof(ratio), "%.2f", (stats.numPixelsDrawn / double(stats.numPixelsCovered)));
+
+                        return ratio;
+                    };
+
+                    ktext_add_ui_text(std::string("Overdraw unsorted/sorted (T to toggle): ") + overdraw(lastRasterStats[0]) +
+                                      "/" + overdraw(lastRasterStats[1]) +
+                                      (isTriangleOrderSorted? " (sorted)" : " (unsorted)"), {10, 100});
+                }
+
+                landscapeFog.apply(renderBuffer, depthMap);
 
                 renderTime = tim.elapsed();
             }
@@ -167,7 +319,7 @@ int main(void)
             // Paint the new frame to screen.
             {
                 kd_update_display(renderBuffer);
-                //kd_update_display(depthMap.as<uint8_t, 4>(0.7));
+                //kd_update_display(depthMap.as<uint8_t, 4>(0.7, 0, 255, &frameImagePool));
 
                 totalTime = tim.elapsed();
             }
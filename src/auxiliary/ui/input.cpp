@@ -13,6 +13,10 @@ static bool MOVING_BACKWARD = false;
 static bool MOVING_LEFT = false;
 static bool MOVING_RIGHT = false;
 
+// Whether the user has asked to toggle the sorting of triangles since this was
+// last queried.
+static bool TRIANGLE_SORTING_TOGGLED = false;
+
 /// Temp hack for movement. Good enough for testing, but will be replaced later.
 void kinput_reset_input_state(void)
 {
@@ -20,6 +24,7 @@ void kinput_reset_input_state(void)
     MOVING_BACKWARD = false;
     MOVING_LEFT = false;
     MOVING_RIGHT = false;
+    TRIANGLE_SORTING_TOGGLED = false;
 
     return;
 }
@@ -79,3 +84,21 @@ void kinput_move_camera_left(const bool isMoving)
 
     return;
 }
+
+// Returns true if the user has asked to toggle the sorting of triangles since
+// the previous call.
+bool kinput_is_triangle_sorting_toggled(void)
+{
+    const bool isToggled = TRIANGLE_SORTING_TOGGLED;
+
+    TRIANGLE_SORTING_TOGGLED = false;
+
+    return isToggled;
+}
+
+void kinput_toggle_triangle_sorting(void)
+{
+    TRIANGLE_SORTING_TOGGLED = true;
+
+    return;
+}
@@ -25,4 +25,8 @@ void kinput_move_camera_left(const bool isMoving);
 
 void kinput_move_camera_right(const bool isMoving);
 
+bool kinput_is_triangle_sorting_toggled(void);
+
+void kinput_toggle_triangle_sorting(void);
+
 #endif
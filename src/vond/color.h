@@ -7,6 +7,8 @@
 #ifndef VOND_COLOR_H
 #define VOND_COLOR_H
 
+#include <cstdint>
+#include <cstring>
 #include "vond/assert.h"
 
 namespace vond
@@ -58,6 +60,53 @@ namespace vond
 
     template <typename T>
     using color_rgba = color<T, 4>;
+
+    // Returns the bilinear blend of the given 2 x 2 block of RGBA8 colors, where
+    // xFrac and yFrac (0 to 255) are the sample point's position between the left
+    // and right colors and the top and bottom ones, in 1/256ths.
+    //
+    // The four channels are blended at once in integer math: the red and blue
+    // channels, and the green and alpha ones, are processed as pairs of 16-bit
+    // lanes in a 32-bit word, scaled by 8-bit weights that sum to 256.
+    inline vond::color_rgba<uint8_t> bilinear_blend_rgba8(const vond::color_rgba<uint8_t> &topLeft,
+                                                          const vond::color_rgba<uint8_t> &topRight,
+                                                          const vond::color_rgba<uint8_t> &bottomLeft,
+                                                          const vond::color_rgba<uint8_t> &bottomRight,
+                                                          const uint32_t xFrac,
+                                                          const uint32_t yFrac)
+    {
+        const uint32_t wBottomRight = ((xFrac * yFrac) >> 8);
+        const uint32_t wTopRight = (xFrac - wBottomRight);
+        const uint32_t wBottomLeft = (yFrac - wBottomRight);
+        const uint32_t wTopLeft = (256 - xFrac - yFrac + wBottomRight);
+
+        uint32_t p[4];
+        std::memcpy(&p[0], topLeft.channel, 4);
+        std::memcpy(&p[1], topRight.channel, 4);
+        std::memcpy(&p[2], bottomLeft.channel, 4);
+        std::memcpy(&p[3], bottomRight.channel, 4);
+
+        // Each lane's weighted sum is at most 255 * 256, so the lanes don't carry
+        // into each other. The 0x80 rounds the result to the nearest.
+        const uint32_t evenChannels = (((p[0] & 0x00ff00ff) * wTopLeft) +
+                                       ((p[1] & 0x00ff00ff) * wTopRight) +
+                                       ((p[2] & 0x00ff00ff) * wBottomLeft) +
+                                       ((p[3] & 0x00ff00ff) * wBottomRight) +
+                                       0x00800080);
+
+        const uint32_t oddChannels = ((((p[0] >> 8) & 0x00ff00ff) * wTopLeft) +
+                                      (((p[1] >> 8) & 0x00ff00ff) * wTopRight) +
+                                      (((p[2] >> 8) & 0x00ff00ff) * wBottomLeft) +
+                                      (((p[3] >> 8) & 0x00ff00ff) * wBottomRight) +
+                                      0x00800080);
+
+        const uint32_t blended = (((evenChannels >> 8) & 0x00ff00ff) | (oddChannels & 0xff00ff00));
+
+        vond::color_rgba<uint8_t> color;
+        std::memcpy(color.channel, &blended, 4);
+
+        return color;
+    }
 }
 
 #endif
@@ -0,0 +1,121 @@
+/*
+ * 2021 Tarpeeksi Hyvae Soft
+ *
+ * Software: Vond
+ *
+ * Builds and queries a max-depth pyramid of a depth map.
+ *
+ */
+
+#include <algorithm>
+#include "vond/depth_pyramid.h"
+
+// The width and height, in pixels, of the cells in the pyramid's finest level.
+static const unsigned CELL_SIZE = 4;
+
+void vond::depth_pyramid::build(const vond::image<double, 1> &depthmap)
+{
+    this->levels.clear();
+
+    // The finest level, from the depth map.
+    {
+        level_s level;
+        level.width = ((depthmap.width() + CELL_SIZE - 1) / CELL_SIZE);
+        level.height = ((depthmap.height() + CELL_SIZE - 1) / CELL_SIZE);
+        level.maxDepths.resize(level.width * level.height);
+
+        #pragma omp parallel for
+        for (unsigned cellY = 0; cellY < level.height; cellY++)
+        {
+            for (unsigned cellX = 0; cellX < level.width; cellX++)
+            {
+                const unsigned endX = std::min(((cellX + 1) * CELL_SIZE), depthmap.width());
+                const unsigned endY = std::min(((cellY + 1) * CELL_SIZE), depthmap.height());
+                double maxDepth = 0;
+
+                for (unsigned y = (cellY * CELL_SIZE); y < endY; y++)
+                {
+                    for (unsigned x = (cellX * CELL_SIZE); x < endX; x++)
+                    {
+                        maxDepth = std::max(maxDepth, depthmap.pixel_at<vond::image_bounds_checking_mode_e::none>(x, y)[0]);
+                    }
+                }
+
+                level.maxDepths[cellX + cellY * level.width] = maxDepth;
+            }
+        }
+
+        this->levels.push_back(std::move(level));
+    }
+
+    // The coarser levels, each from the previous one.
+    while ((this->levels.back().width > 1) ||
+           (this->levels.back().height > 1))
+    {
+        const level_s &finer = this->levels.back();
+
+        level_s level;
+        level.width = ((finer.width + 1) / 2);
+        level.height = ((finer.height + 1) / 2);
+        level.maxDepths.resize(level.width * level.height);
+
+        for (unsigned y = 0; y < level.height; y++)
+        {
+            for (unsigned x = 0; x < level.width; x++)
+            {
+                const unsigned x2 = std::min(((x * 2) + 1), (finer.width - 1));
+                const unsigned y2 = std::min(((y * 2) + 1), (finer.height - 1));
+
+                level.maxDepths[x + y * level.width] = std::max({finer.max_depth_at((x * 2), (y * 2)),
+                                                                 finer.max_depth_at(x2, (y * 2)),
+                                                                 finer.max_depth_at((x * 2), y2),
+                                                                 finer.max_depth_at(x2, y2)});
+            }
+        }
+
+        this->levels.push_back(std::move(level));
+    }
+
+    return;
+}
+
+bool vond::depth_pyramid::is_occluded(const vond::rect<int> &screenRect, const double nearestDepth) const
+{
+    if (this->levels.empty() ||
+        (screenRect.left() < 0) ||
+        (screenRect.top() < 0))
+    {
+        return false;
+    }
+
+    // Pick the finest level whose cells are at least as large as the rectangle,
+    // so that the rectangle overlaps at most 2 x 2 of them.
+    unsigned levelIdx = 0;
+    {
+        const unsigned rectSize = (std::max(screenRect.width(), screenRect.height()) + 1);
+
+        while (((CELL_SIZE << levelIdx) < rectSize) &&
+               ((levelIdx + 1) < this->levels.size()))
+        {
+            levelIdx++;
+        }
+    }
+
+    const level_s &level = this->levels[levelIdx];
+    const unsigned cellSize = (CELL_SIZE << levelIdx);
+    const unsigned endX = std::min((screenRect.right() / cellSize), (level.width - 1));
+    const unsigned endY = std::min((screenRect.bottom() / cellSize), (level.height - 1));
+
+    for (unsigned y = (screenRect.top() / cellSize); y <= endY; y++)
+    {
+        for (unsigned x = (screenRect.left() / cellSize); x <= endX; x++)
+        {
+            if (level.max_depth_at(x, y) >= nearestDepth)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,53 @@
+/*
+ * 2021 Tarpeeksi Hyvae Soft
+ *
+ * Software: Vond
+ *
+ */
+
+#ifndef VOND_DEPTH_PYRAMID_H
+#define VOND_DEPTH_PYRAMID_H
+
+#include <vector>
+#include "vond/image.h"
+#include "vond/rect.h"
+
+namespace vond
+{
+    // A hierarchical Z buffer: a pyramid of progressively coarser versions of a
+    // depth map, in which each cell holds the farthest depth among the pixels it
+    // covers. Whether anything nearer than a given depth could still be visible
+    // anywhere within a screen rectangle can then be found by looking at a few
+    // cells rather than at every pixel - so that geometry hidden behind what's
+    // already been drawn can be rejected before it's rasterized.
+    class depth_pyramid
+    {
+    public:
+        // Rebuilds the pyramid from the given depth map.
+        void build(const vond::image<double, 1> &depthmap);
+
+        // Returns true if every pixel within the given screen rectangle (edges
+        // inclusive) is nearer than the given depth; i.e. if something at that
+        // depth or farther would be hidden in all of the rectangle. Returns false
+        // if the pyramid hasn't been built.
+        bool is_occluded(const vond::rect<int> &screenRect, const double nearestDepth) const;
+
+    private:
+        struct level_s
+        {
+            unsigned width;
+            unsigned height;
+            std::vector<double> maxDepths;
+
+            double max_depth_at(const unsigned x, const unsigned y) const
+            {
+                return this->maxDepths[x + y * this->width];
+            }
+        };
+
+        // The pyramid's levels, from finest to coarsest.
+        std::vector<level_s> levels;
+    };
+}
+
+#endif
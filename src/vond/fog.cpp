@@ -0,0 +1,78 @@
+/*
+ * 2021 Tarpeeksi Hyvae Soft
+ *
+ * Software: Vond
+ *
+ * Applies distance fog to a rendered image.
+ *
+ */
+
+#include <cmath>
+#include <algorithm>
+#include "vond/fog.h"
+#include "vond/assert.h"
+
+// The number of distance steps in the fog's lookup table.
+static const unsigned LUT_SIZE = 1024;
+
+// The fog's opacity at its visibility distance. Beyond this, the fog hides any
+// color differences in an 8-bit image.
+static const double OPAQUE_THRESHOLD = (254.5 / 255.0);
+
+vond::fog::fog(const double density,
+               const vond::color_rgb<uint8_t> &color,
+               const vond::color_rgb<uint8_t> &hazeColor) :
+    color_(color),
+    visibilityDistance(-log(1 - OPAQUE_THRESHOLD) / density),
+    lutScale((LUT_SIZE - 1) / this->visibilityDistance),
+    lut(LUT_SIZE)
+{
+    vond_assert((density > 0), "The fog's density must be positive.");
+
+    for (unsigned i = 0; i < LUT_SIZE; i++)
+    {
+        const double distance = (i / this->lutScale);
+        const double opacity = ((i == (LUT_SIZE - 1))? 1 : (1 - exp(-density * distance)));
+
+        for (unsigned c = 0; c < 3; c++)
+        {
+            this->lut[i].color[c] = uint16_t(round(std::lerp(double(hazeColor[c]), double(color[c]), opacity)));
+        }
+
+        this->lut[i].opacity = uint16_t(round(opacity * 256));
+    }
+
+    return;
+}
+
+void vond::fog::apply(vond::image<uint8_t, 4> &dstPixelmap,
+                      const vond::image<double, 1> &depthmap) const
+{
+    vond_assert((dstPixelmap.width() == depthmap.width()) &&
+                (dstPixelmap.height() == depthmap.height()),
+                "The pixel map must have the same resolution as the depth map.");
+
+    #pragma omp parallel for
+    for (unsigned y = 0; y < dstPixelmap.height(); y++)
+    {
+        for (unsigned x = 0; x < dstPixelmap.width(); x++)
+        {
+            const double depth = depthmap.pixel_at<vond::image_bounds_checking_mode_e::none>(x, y)[0];
+
+            if (depth == std::numeric_limits<double>::max())
+            {
+                continue;
+            }
+
+            const lut_entry_s &fog = this->lut[unsigned(std::min(double(LUT_SIZE - 1), (depth * this->lutScale)))];
+            vond::color_rgba<uint8_t> &pixel = dstPixelmap.pixel_at<vond::image_bounds_checking_mode_e::none>(x, y);
+
+            for (unsigned c = 0; c < 3; c++)
+            {
+                pixel.channel_at(c) = uint8_t(((pixel[c] * (256 - fog.opacity)) + (fog.color[c] * fog.opacity)) >> 8);
+            }
+        }
+    }
+
+    return;
+}
@@ -0,0 +1,63 @@
+/*
+ * 2021 Tarpeeksi Hyvae Soft
+ *
+ * Software: Vond
+ *
+ */
+
+#ifndef VOND_FOG_H
+#define VOND_FOG_H
+
+#include <vector>
+#include "vond/image.h"
+#include "vond/color.h"
+
+namespace vond
+{
+    // Exponential distance fog with aerial perspective: with distance, surfaces
+    // first take on the tint of the haze color and then fade into the fog color.
+    //
+    // The fog's color and strength at each distance are precomputed into a lookup
+    // table, so applying the fog costs one table lookup and blend per pixel. Since
+    // the fog fully obscures everything beyond its visibility distance, renderers
+    // needn't trace farther than that.
+    class fog
+    {
+    public:
+        fog(const double density,
+            const vond::color_rgb<uint8_t> &color,
+            const vond::color_rgb<uint8_t> &hazeColor);
+
+        // Fogs the given pixel map according to the depths in the given depth map.
+        // Pixels at infinite depth (e.g. the sky) are left as they are.
+        void apply(vond::image<uint8_t, 4> &dstPixelmap,
+                   const vond::image<double, 1> &depthmap) const;
+
+        // Returns the distance beyond which the fog is fully opaque.
+        double visibility_distance(void) const
+        {
+            return this->visibilityDistance;
+        }
+
+        vond::color_rgb<uint8_t> color(void) const
+        {
+            return this->color_;
+        }
+
+    private:
+        // A lookup table entry: the fog's color and its opacity (0-256) at a given
+        // distance.
+        struct lut_entry_s
+        {
+            uint16_t color[3];
+            uint16_t opacity;
+        };
+
+        const vond::color_rgb<uint8_t> color_;
+        const double visibilityDistance;
+        const double lutScale;
+        std::vector<lut_entry_s> lut;
+    };
+}
+
+#endif
@@ -0,0 +1,82 @@
+/*
+ * 2021 Tarpeeksi Hyvae Soft
+ *
+ * Software: Vond
+ *
+ * Extracts view frustum planes from a projection matrix, after Gribb & Hartmann,
+ * "Fast Extraction of Viewing Frustum Planes from the World-View-Projection
+ * Matrix" (2001).
+ *
+ */
+
+#include <cmath>
+#include "vond/frustum.h"
+
+vond::frustum::frustum(const vond::matrix44 &toClipSpace)
+{
+    const auto &m = toClipSpace;
+
+    // A point is inside the frustum if -w <= x, y, z <= w in clip space, which
+    // for each plane is a linear inequality in the point's world coordinates
+    // whose coefficients are sums or differences of the matrix's rows.
+    const auto make_plane = [&m](const unsigned row, const double sign)->plane_s
+    {
+        const double a = (m(3, 0) + (sign * m(row, 0)));
+        const double b = (m(3, 1) + (sign * m(row, 1)));
+        const double c = (m(3, 2) + (sign * m(row, 2)));
+        const double d = (m(3, 3) + (sign * m(row, 3)));
+        const double length = sqrt((a * a) + (b * b) + (c * c));
+
+        return {{(a / length), (b / length), (c / length)}, (d / length)};
+    };
+
+    this->planes[0] = make_plane(0, 1);
+    this->planes[1] = make_plane(0, -1);
+    this->planes[2] = make_plane(1, 1);
+    this->planes[3] = make_plane(1, -1);
+    this->planes[4] = make_plane(2, 1);
+
+    return;
+}
+
+bool vond::frustum::intersects_sphere(const vond::vector3<double> &center, const double radius) const
+{
+    for (const plane_s &plane: this->planes)
+    {
+        if ((plane.normal.dot(center) + plane.d) < -radius)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+vond::frustum::containment_e vond::frustum::classify_box(const vond::vector3<double> &min, const vond::vector3<double> &max) const
+{
+    containment_e containment = containment_e::inside;
+
+    for (const plane_s &plane: this->planes)
+    {
+        // The box's corners farthest toward and away from the frustum's inside
+        // along the plane's normal.
+        vond::vector3<double> innermostCorner, outermostCorner;
+        for (unsigned i = 0; i < 3; i++)
+        {
+            innermostCorner[i] = ((plane.normal[i] >= 0)? max[i] : min[i]);
+            outermostCorner[i] = ((plane.normal[i] >= 0)? min[i] : max[i]);
+        }
+
+        if ((plane.normal.dot(innermostCorner) + plane.d) < 0)
+        {
+            return containment_e::outside;
+        }
+
+        if ((plane.normal.dot(outermostCorner) + plane.d) < 0)
+        {
+            containment = containment_e::partial;
+        }
+    }
+
+    return containment;
+}
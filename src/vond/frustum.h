@@ -0,0 +1,53 @@
+/*
+ * 2021 Tarpeeksi Hyvae Soft
+ *
+ * Software: Vond
+ *
+ */
+
+#ifndef VOND_FRUSTUM_H
+#define VOND_FRUSTUM_H
+
+#include "vond/matrix.h"
+#include "vond/vector.h"
+
+namespace vond
+{
+    // The camera's view volume as a set of planes, for culling objects that are
+    // out of view. Has no far plane; objects are visible at any distance.
+    class frustum
+    {
+    public:
+        // Extracts the frustum's planes from the given world-to-clip space matrix
+        // (i.e. perspective * camera).
+        frustum(const vond::matrix44 &toClipSpace);
+
+        // Returns true if the given sphere is at least partly inside the frustum.
+        bool intersects_sphere(const vond::vector3<double> &center, const double radius) const;
+
+        enum class containment_e
+        {
+            outside,
+            partial,
+            inside
+        };
+
+        // Returns whether the given axis-aligned box is outside the frustum, fully
+        // inside it, or partly inside. May report a box that's just outside near
+        // the frustum's corners as partly inside.
+        containment_e classify_box(const vond::vector3<double> &min, const vond::vector3<double> &max) const;
+
+    private:
+        // A plane n . p + d = 0, with n normalized and pointing into the frustum.
+        struct plane_s
+        {
+            vond::vector3<double> normal;
+            double d;
+        };
+
+        // Left, right, bottom, top and near.
+        plane_s planes[5];
+    };
+}
+
+#endif
@@ -0,0 +1,131 @@
+/*
+ * 2021 Tarpeeksi Hyvae Soft
+ *
+ * Software: Vond
+ *
+ * Builds and queries horizon maps for shadowing a heightmap-based landscape from
+ * the sun.
+ *
+ */
+
+#include <cmath>
+#include <algorithm>
+#include "vond/horizon_map.h"
+#include "vond/assert.h"
+
+// The angular width, in radians, over which the sun fades from fully lit to fully
+// shadowed as it sinks below the horizon. Softens the shadow edges somewhat.
+static const double PENUMBRA_ANGLE = (2 * (M_PI / 180.0));
+
+vond::horizon_map::horizon_map(const vond::image<double, 1> &heightmap,
+                               const unsigned numAzimuths,
+                               const unsigned maxSearchDistance) :
+    heightmap(heightmap),
+    numAzimuths(numAzimuths),
+    maxSearchDistance(maxSearchDistance),
+    slices(numAzimuths),
+    numRowsBuilt(numAzimuths, 0)
+{
+    vond_assert((numAzimuths >= 2), "A horizon map needs at least two azimuth directions.");
+
+    return;
+}
+
+void vond::horizon_map::set_sun_direction(const vond::vector3<double> &sunDirection)
+{
+    double azimuth = atan2(sunDirection[2], sunDirection[0]);
+    if (azimuth < 0)
+    {
+        azimuth += (2 * M_PI);
+    }
+
+    const double slicePos = (azimuth / ((2 * M_PI) / this->numAzimuths));
+
+    this->sunSlices[0] = (unsigned(slicePos) % this->numAzimuths);
+    this->sunSlices[1] = ((this->sunSlices[0] + 1) % this->numAzimuths);
+    this->sunSliceBlend = (slicePos - floor(slicePos));
+    this->sunElevation = atan2(sunDirection[1], sqrt((sunDirection[0] * sunDirection[0]) +
+                                                     (sunDirection[2] * sunDirection[2])));
+
+    return;
+}
+
+bool vond::horizon_map::update(const unsigned maxNumRows)
+{
+    unsigned rowBudget = maxNumRows;
+
+    for (const unsigned sliceIdx: this->sunSlices)
+    {
+        if (!this->slices[sliceIdx])
+        {
+            this->slices[sliceIdx] = std::make_unique<vond::image<float, 1>>(this->heightmap.width(), this->heightmap.height(), 32);
+        }
+
+        const unsigned startRow = this->numRowsBuilt[sliceIdx];
+        const unsigned endRow = (startRow + std::min(rowBudget, (this->heightmap.height() - startRow)));
+
+        #pragma omp parallel for
+        for (unsigned y = startRow; y < endRow; y++)
+        {
+            this->build_row(sliceIdx, y);
+        }
+
+        this->numRowsBuilt[sliceIdx] = endRow;
+        rowBudget -= (endRow - startRow);
+    }
+
+    return ((this->numRowsBuilt[this->sunSlices[0]] == this->heightmap.height()) &&
+            (this->numRowsBuilt[this->sunSlices[1]] == this->heightmap.height()));
+}
+
+void vond::horizon_map::build_row(const unsigned sliceIdx, const unsigned y)
+{
+    const double azimuth = (sliceIdx * ((2 * M_PI) / this->numAzimuths));
+    const double dirX = cos(azimuth);
+    const double dirY = sin(azimuth);
+
+    vond::image<float, 1> &slice = *this->slices[sliceIdx];
+
+    for (unsigned x = 0; x < this->heightmap.width(); x++)
+    {
+        const double originHeight = this->heightmap.pixel_at<vond::image_bounds_checking_mode_e::none>(x, y)[0];
+        double maxSlope = 0;
+
+        // March away from the texel, taking longer steps the farther out we are,
+        // since distant terrain needs to rise proportionally higher to occlude.
+        for (double t = 1; t < this->maxSearchDistance; t += (1 + (t / 32)))
+        {
+            const double height = this->heightmap.pixel_at(round(x + (dirX * t)), round(y + (dirY * t)))[0];
+
+            maxSlope = std::max(maxSlope, ((height - originHeight) / t));
+        }
+
+        slice.pixel_at<vond::image_bounds_checking_mode_e::none>(x, y) = {float(atan(maxSlope))};
+    }
+
+    return;
+}
+
+double vond::horizon_map::sun_visibility(const double x, const double y) const
+{
+    const int texelX = std::clamp(int(x), 0, int(this->heightmap.width() - 1));
+    const int texelY = std::clamp(int(y), 0, int(this->heightmap.height() - 1));
+
+    double horizonAngle[2];
+
+    for (unsigned i = 0; i < 2; i++)
+    {
+        const unsigned sliceIdx = this->sunSlices[i];
+
+        if (unsigned(texelY) >= this->numRowsBuilt[sliceIdx])
+        {
+            return 1;
+        }
+
+        horizonAngle[i] = this->slices[sliceIdx]->pixel_at<vond::image_bounds_checking_mode_e::none>(texelX, texelY)[0];
+    }
+
+    const double horizon = std::lerp(horizonAngle[0], horizonAngle[1], this->sunSliceBlend);
+
+    return std::clamp((((this->sunElevation - horizon) / PENUMBRA_ANGLE) + 0.5), 0.0, 1.0);
+}
@@ -0,0 +1,80 @@
+/*
+ * 2021 Tarpeeksi Hyvae Soft
+ *
+ * Software: Vond
+ *
+ */
+
+#ifndef VOND_HORIZON_MAP_H
+#define VOND_HORIZON_MAP_H
+
+#include <vector>
+#include <memory>
+#include <limits>
+#include "vond/image.h"
+#include "vond/vector.h"
+
+namespace vond
+{
+    // Precomputed terrain horizons for shadowing a heightmap from the sun. For each
+    // texel of the heightmap and for each of a number of evenly-spaced azimuth
+    // directions, stores the elevation angle of the horizon as seen from that texel
+    // toward that direction. A point on the terrain is in shadow if the sun is
+    // below the horizon in the sun's azimuth, so finding whether a terrain point is
+    // lit becomes a lookup rather than a ray march.
+    //
+    // Only the azimuth slices adjacent to the sun's current azimuth are needed, so
+    // slices are built on demand - and a number of rows at a time, if desired - as
+    // the sun moves.
+    //
+    // The search for horizons reads the heightmap in its own bounds-checking mode,
+    // so a wrapping heightmap casts shadows across its edges.
+    class horizon_map
+    {
+    public:
+        horizon_map(const vond::image<double, 1> &heightmap,
+                    const unsigned numAzimuths = 16,
+                    const unsigned maxSearchDistance = 256);
+
+        // Sets the direction toward the sun (need not be normalized). Any azimuth
+        // slices that the new direction requires but that haven't yet been built
+        // will be built by subsequent calls to update().
+        void set_sun_direction(const vond::vector3<double> &sunDirection);
+
+        // Builds at most the given number of rows of the azimuth slices required by
+        // the current sun direction. Returns true if all of the required slices are
+        // fully built; false otherwise.
+        bool update(const unsigned maxNumRows = std::numeric_limits<unsigned>::max());
+
+        // Returns the amount of sunlight - from 0 (in shadow) to 1 (fully lit) -
+        // reaching the terrain at the given heightmap XY coordinates. Parts of the
+        // map that haven't yet been built are considered fully lit.
+        double sun_visibility(const double x, const double y) const;
+
+    private:
+        // Computes the horizon elevation angles for the given row of the given
+        // azimuth slice.
+        void build_row(const unsigned sliceIdx, const unsigned y);
+
+        const vond::image<double, 1> &heightmap;
+        const unsigned numAzimuths;
+        const unsigned maxSearchDistance;
+
+        // The horizon elevation angles (in radians), one image per azimuth slice.
+        // Slices are allocated when first needed.
+        std::vector<std::unique_ptr<vond::image<float, 1>>> slices;
+
+        // For each azimuth slice, the number of rows that have been built so far.
+        std::vector<unsigned> numRowsBuilt;
+
+        // The indices of the two azimuth slices that bracket the sun's azimuth, and
+        // the sun's position between them (0 = first slice, 1 = second slice).
+        unsigned sunSlices[2] = {0, 1};
+        double sunSliceBlend = 0;
+
+        // The sun's elevation angle above the horizontal plane, in radians.
+        double sunElevation = (M_PI / 2);
+    };
+}
+
+#endif
@@ -7,10 +7,16 @@
 #ifndef VOND_IMAGE_H
 #define VOND_IMAGE_H
 
+#include <type_traits>
+#include <algorithm>
+#include <cmath>
+#include <utility>
 #include <QImage>
 #include <QColor>
 #include "vond/vector.h"
 #include "vond/color.h"
+#include "vond/image_view.h"
+#include "vond/image_buffer_pool.h"
 
 namespace vond
 {
@@ -21,22 +27,74 @@ namespace vond
         none,
         clamped,
         wrapped,
+
+        // As wrapped, but for images whose width and height are powers of two;
+        // integer coordinates then wrap with a bitmask.
+        wrapped_pow2,
     };
 
+    // Returns the bilinearly filtered color of a width x height RGBA8 image at the
+    // given 16.16 fixed-point coordinates, clamped to the image's edges. The image
+    // must be at least 2 x 2 pixels. Images whose texels aren't stored row by row
+    // provide their own addressing: texelIndices(x, y, idx) fills in idx with the
+    // indices in the texel array of the 2 x 2 texels whose top left texel is at
+    // x,y - top left, top right, bottom left and bottom right.
+    template <typename TexelIndicesFn>
+    vond::color_rgba<uint8_t> bilinear_sample_fixed_clamped(const vond::color_rgba<uint8_t> *const texels,
+                                                            const unsigned width,
+                                                            const unsigned height,
+                                                            int32_t x,
+                                                            int32_t y,
+                                                            const TexelIndicesFn &texelIndices)
+    {
+        if (x < 0) x = 0;
+        else if (x >= int32_t(width << 16)) x = int32_t((width - 1) << 16);
+        if (y < 0) y = 0;
+        else if (y >= int32_t(height << 16)) y = int32_t((height - 1) << 16);
+
+        unsigned x1 = (x >> 16);
+        unsigned y1 = (y >> 16);
+
+        if (x1 >= (width - 1)) x1 = (width - 2);
+        if (y1 >= (height - 1)) y1 = (height - 2);
+
+        unsigned idx[4];
+        texelIndices(x1, y1, idx);
+
+        return vond::bilinear_blend_rgba8(texels[idx[0]],
+                                          texels[idx[1]],
+                                          texels[idx[2]],
+                                          texels[idx[3]],
+                                          ((x >> 8) & 0xff),
+                                          ((y >> 8) & 0xff));
+    }
+
+    // An image whose pixels are color<T, NumColorChannels>, stored row by row in a
+    // buffer aligned for SIMD. Copying an image copies its pixels; moving one
+    // moves only the buffer. For cheap non-owning access to an image or a part of
+    // it, see view().
     template <typename T, std::size_t NumColorChannels>
     struct image
     {
-        image(const unsigned width, const unsigned height, const unsigned bpp) :
+        // If a buffer pool is given, the image's pixel buffer is taken from it and
+        // returned to it when the image is destroyed.
+        image(const unsigned width,
+              const unsigned height,
+              const unsigned bpp,
+              vond::image_buffer_pool *const pool = nullptr) :
             width_(width),
             height_(height),
             bpp_(bpp),
-            pixels_(new vond::color<T, NumColorChannels>[width * height])
+            pool(pool)
         {
             vond_assert(((this->width() > 0) &&
                     (this->height() > 0) &&
                     (this->bpp() > 0)),
                     "Invalid image resolution detected.");
 
+            this->pixels_ = (vond::color<T, NumColorChannels>*)(pool? pool->acquire(this->num_bytes())
+                                                                    : vond::allocate_image_buffer(this->num_bytes()));
+
             this->fill({0});
 
             return;
@@ -48,56 +106,179 @@ namespace vond
             return;
         }
 
+        // The copy's pixel buffer comes from the same pool as the other image's.
+        // Copying an empty (e.g. moved-from) image gives an empty image.
+        image(const image<T, NumColorChannels> &other) :
+            boundsCheckingMode(other.boundsCheckingMode),
+            width_(other.width_),
+            height_(other.height_),
+            bpp_(other.bpp_),
+            pixels_(nullptr),
+            pool(other.pool)
+        {
+            if (other.pixels_)
+            {
+                // The buffer is overwritten in full, so unlike in the other
+                // constructors it isn't cleared first.
+                this->pixels_ = (vond::color<T, NumColorChannels>*)(this->pool? this->pool->acquire(this->num_bytes())
+                                                                              : vond::allocate_image_buffer(this->num_bytes()));
+
+                std::copy_n(other.pixels_, (this->width() * this->height()), this->pixels_);
+            }
+
+            return;
+        }
+
+        // Leaves the other image empty: with no pixels and a resolution of 0 x 0.
+        image(image<T, NumColorChannels> &&other) noexcept :
+            boundsCheckingMode(other.boundsCheckingMode),
+            width_(std::exchange(other.width_, 0)),
+            height_(std::exchange(other.height_, 0)),
+            bpp_(other.bpp_),
+            pixels_(std::exchange(other.pixels_, nullptr)),
+            pool(other.pool)
+        {
+            return;
+        }
+
+        image<T, NumColorChannels>& operator=(image<T, NumColorChannels> other) noexcept
+        {
+            std::swap(this->boundsCheckingMode, other.boundsCheckingMode);
+            std::swap(this->width_, other.width_);
+            std::swap(this->height_, other.height_);
+            std::swap(this->bpp_, other.bpp_);
+            std::swap(this->pixels_, other.pixels_);
+            std::swap(this->pool, other.pool);
+
+            return *this;
+        }
+
         ~image(void)
         {
-            delete [] pixels_;
+            if (this->pixels_)
+            {
+                if (this->pool)
+                {
+                    this->pool->release(this->pixels_, this->num_bytes());
+                }
+                else
+                {
+                    vond::free_image_buffer(this->pixels_);
+                }
+            }
 
             return;
         }
 
+        // Returns an image with the given QImage's pixels. The RGB channels of color
+        // images are copied into the image's channels in order, with any fourth
+        // channel fully opaque; the value of grayscale and palettized images goes
+        // into every channel. 16-bit grayscale images (e.g. heightmaps) are scaled
+        // into the same 0-255 range as 8-bit ones, keeping their precision in
+        // floating-point images.
         static vond::image<T, NumColorChannels> from_QImage(const QImage &qImage)
         {
             vond_assert(!qImage.isNull(), "Was asked to create an image out of a null QImage.");
 
             vond::image<T, NumColorChannels> image(qImage.width(), qImage.height(), qImage.depth());
+            const vond::image_view<T, NumColorChannels> pixels = image.view();
+            const unsigned width = image.width();
+            const int height = int(image.height());
+
+            // The source image is brought into one of a few known formats, if not
+            // already in one, and then copied over from its raw scanlines, with the
+            // rows processed in parallel.
+            if (qImage.format() == QImage::Format_Grayscale16)
+            {
+                #pragma omp parallel for
+                for (int y = 0; y < height; y++)
+                {
+                    const uint16_t *const src = (const uint16_t*)qImage.constScanLine(y);
+                    vond::color<T, NumColorChannels> *const dst = pixels.row(y);
 
-            // Copy the pixels over.
-            for (unsigned y = 0; y < image.height(); y++)
+                    for (unsigned x = 0; x < width; x++)
+                    {
+                        const T value = (std::is_floating_point_v<T>? T(src[x] / 257.0) : T((src[x] + 128) / 257));
+
+                        for (unsigned i = 0; i < NumColorChannels; i++)
+                        {
+                            dst[x].channel[i] = value;
+                        }
+                    }
+                }
+            }
+            else if (qImage.depth() == 8)
             {
-                for (unsigned x = 0; x < image.width(); x++)
+                // Map the 8-bit pixels to their value (brightness) via a lookup
+                // table, which for palettized images is built from the palette.
+                const bool isConverted = ((qImage.format() != QImage::Format_Grayscale8) &&
+                                          (qImage.format() != QImage::Format_Indexed8));
+                const QImage converted = (isConverted? qImage.convertToFormat(QImage::Format_Grayscale8) : QImage());
+                const QImage &gray = (isConverted? converted : qImage);
+
+                T values[256];
+                for (unsigned i = 0; i < 256; i++)
+                {
+                    values[i] = ((gray.format() == QImage::Format_Indexed8)
+                                 ? T((int(i) < gray.colorCount())? QColor(gray.color(i)).value() : 0)
+                                 : T(i));
+                }
+
+                #pragma omp parallel for
+                for (int y = 0; y < height; y++)
                 {
-                    const QColor sourcePixel = qImage.pixel(x, y);
-                    vond::color<T, NumColorChannels> &targetPixel = image.pixel_at(x, y);
+                    const uint8_t *const src = gray.constScanLine(y);
+                    vond::color<T, NumColorChannels> *const dst = pixels.row(y);
 
-                    switch (image.bpp())
+                    for (unsigned x = 0; x < width; x++)
                     {
-                        case 8:
+                        for (unsigned i = 0; i < NumColorChannels; i++)
                         {
-                            for (unsigned i = 0; i < NumColorChannels; i++)
-                            {
-                                targetPixel.channel_at(i) = T(sourcePixel.value());
-                            }
+                            dst[x].channel[i] = values[src[x]];
+                        }
+                    }
+                }
+            }
+            else
+            {
+                // The alpha channel is ignored, so ARGB32 reads as RGB32 (0xffRRGGBB).
+                const bool isConverted = ((qImage.format() != QImage::Format_RGB32) &&
+                                          (qImage.format() != QImage::Format_ARGB32));
+                const QImage converted = (isConverted? qImage.convertToFormat(QImage::Format_RGB32) : QImage());
+                const QImage &rgb = (isConverted? converted : qImage);
+
+                #pragma omp parallel for
+                for (int y = 0; y < height; y++)
+                {
+                    const QRgb *const src = (const QRgb*)rgb.constScanLine(y);
+                    vond::color<T, NumColorChannels> *const dst = pixels.row(y);
 
-                            break;
+                    // For RGBA8, a plain channel shuffle that the compiler can
+                    // vectorize.
+                    if constexpr (std::is_same_v<T, uint8_t> && (NumColorChannels == 4))
+                    {
+                        #pragma omp simd
+                        for (unsigned x = 0; x < width; x++)
+                        {
+                            dst[x].channel[0] = uint8_t(src[x] >> 16);
+                            dst[x].channel[1] = uint8_t(src[x] >> 8);
+                            dst[x].channel[2] = uint8_t(src[x]);
+                            dst[x].channel[3] = 255;
                         }
-                        case 32:
+                    }
+                    else
+                    {
+                        for (unsigned x = 0; x < width; x++)
                         {
-                            vond::color<int, 4> c = {sourcePixel.red(),
-                                                     sourcePixel.green(),
-                                                     sourcePixel.blue(),
-                                                     255};
+                            const int c[4] = {int((src[x] >> 16) & 0xff),
+                                              int((src[x] >> 8) & 0xff),
+                                              int(src[x] & 0xff),
+                                              255};
 
                             for (unsigned i = 0; i < NumColorChannels; i++)
                             {
-                                targetPixel.channel_at(i) = T(c.channel_at(i % 4));
+                                dst[x].channel[i] = T(c[i % 4]);
                             }
-
-                            break;
-                        }
-                        default:
-                        {
-                            vond_assert(0, "Encountered an unknown color depth when converting from a QImage.");
-                            break;
                         }
                     }
                 }
@@ -121,16 +302,61 @@ namespace vond
             return this->bpp_;
         }
 
+        // Returns the pixel at the given coordinates, bounds-checked according to
+        // the image's bounds-checking mode.
+        vond::color<T, NumColorChannels>& pixel_at(const int x, const int y) const
+        {
+            switch (this->boundsCheckingMode)
+            {
+                case image_bounds_checking_mode_e::none: return this->pixel_at<image_bounds_checking_mode_e::none>(x, y);
+                case image_bounds_checking_mode_e::wrapped: return this->pixel_at<image_bounds_checking_mode_e::wrapped>(x, y);
+                case image_bounds_checking_mode_e::wrapped_pow2: return this->pixel_at<image_bounds_checking_mode_e::wrapped_pow2>(x, y);
+                case image_bounds_checking_mode_e::clamped: return this->pixel_at<image_bounds_checking_mode_e::clamped>(x, y);
+            }
+
+            return this->pixel_at<image_bounds_checking_mode_e::clamped>(x, y);
+        }
+
+        // As pixel_at(x, y), but with the bounds-checking mode given at compile
+        // time rather than taken from the image, so that the check compiles into a
+        // few branchless instructions - or, with image_bounds_checking_mode_e::none,
+        // into nothing, for loops whose coordinates are known to be in bounds.
+        template <image_bounds_checking_mode_e BoundsCheckingMode>
         vond::color<T, NumColorChannels>& pixel_at(int x, int y) const
         {
-            std::tie(x, y) = this->bounds_checked_coordinates(x, y);
+            if constexpr (BoundsCheckingMode == image_bounds_checking_mode_e::clamped)
+            {
+                x = std::clamp(x, 0, int(this->width() - 1));
+                y = std::clamp(y, 0, int(this->height() - 1));
+            }
+            else if constexpr (BoundsCheckingMode == image_bounds_checking_mode_e::wrapped)
+            {
+                x %= int(this->width());
+                y %= int(this->height());
+                if (x < 0) x += this->width();
+                if (y < 0) y += this->height();
+            }
+            else if constexpr (BoundsCheckingMode == image_bounds_checking_mode_e::wrapped_pow2)
+            {
+                vond_optional_assert(this->is_pow2(), "Mask-wrapping an image whose dimensions aren't powers of two.");
+
+                x &= (this->width() - 1);
+                y &= (this->height() - 1);
+            }
 
             vond_optional_assert(pixels_, "Tried to access the pixels of a null image.");
-            vond_optional_assert(((x < this->width()) && (y < this->height())), "Tried to access an image pixel out of bounds.");
+            vond_optional_assert(((unsigned(x) < this->width()) && (unsigned(y) < this->height())), "Tried to access an image pixel out of bounds.");
 
             return pixels_[(x + y * this->width())];
         }
 
+        // Returns true if the image's width and height are both powers of two.
+        bool is_pow2(void) const
+        {
+            return (!(this->width() & (this->width() - 1)) &&
+                    !(this->height() & (this->height() - 1)));
+        }
+
         void bilinear_filter(const unsigned numIterations = 1)
         {
             for (unsigned i = 0; i < numIterations; i++)
@@ -139,7 +365,7 @@ namespace vond
                 {
                     for (unsigned x = 1; x < this->width()-1; x++)
                     {
-                        this->pixel_at(x, y) = this->bilinear_sample(x + 0.5, y + 0.5);
+                        this->pixel_at<image_bounds_checking_mode_e::none>(x, y) = this->bilinear_sample<image_bounds_checking_mode_e::none>(x + 0.5, y + 0.5);
                     }
                 }
             }
@@ -147,9 +373,57 @@ namespace vond
             return;
         }
 
+        vond::color<T, NumColorChannels> bilinear_sample(const double x, const double y) const
+        {
+            switch (this->boundsCheckingMode)
+            {
+                case image_bounds_checking_mode_e::none: return this->bilinear_sample<image_bounds_checking_mode_e::none>(x, y);
+                case image_bounds_checking_mode_e::wrapped: return this->bilinear_sample<image_bounds_checking_mode_e::wrapped>(x, y);
+                case image_bounds_checking_mode_e::wrapped_pow2: return this->bilinear_sample<image_bounds_checking_mode_e::wrapped_pow2>(x, y);
+                case image_bounds_checking_mode_e::clamped: return this->bilinear_sample<image_bounds_checking_mode_e::clamped>(x, y);
+            }
+
+            return this->bilinear_sample<image_bounds_checking_mode_e::clamped>(x, y);
+        }
+
+        // As bilinear_sample(x, y), but with the bounds-checking mode given at
+        // compile time (see pixel_at<>()).
+        template <image_bounds_checking_mode_e BoundsCheckingMode>
         vond::color<T, NumColorChannels> bilinear_sample(double x, double y) const
         {
-            std::tie(x, y) = this->bounds_checked_coordinates(x, y);
+            // The texels to filter between are wrapped individually, so that the
+            // image tiles seamlessly.
+            if constexpr (BoundsCheckingMode == image_bounds_checking_mode_e::wrapped_pow2)
+            {
+                vond_optional_assert(this->is_pow2(), "Mask-wrapping an image whose dimensions aren't powers of two.");
+                vond_optional_assert(pixels_, "Tried to access the pixels of a null image.");
+
+                const int xFloored = int(std::floor(x));
+                const int yFloored = int(std::floor(y));
+                const double xBias = (x - xFloored);
+                const double yBias = (y - yFloored);
+
+                const unsigned x1 = (xFloored & (this->width() - 1));
+                const unsigned y1 = (yFloored & (this->height() - 1));
+                const unsigned x2 = ((xFloored + 1) & (this->width() - 1));
+                const unsigned y2 = ((yFloored + 1) & (this->height() - 1));
+
+                vond::color<T, NumColorChannels> interpolatedPixel;
+
+                for (unsigned i = 0; i < NumColorChannels; i++)
+                {
+                    const T c1 = std::lerp(pixels_[(x1 + y1 * this->width())][i],
+                                           pixels_[(x1 + y2 * this->width())][i], yBias);
+                    const T c2 = std::lerp(pixels_[(x2 + y1 * this->width())][i],
+                                           pixels_[(x2 + y2 * this->width())][i], yBias);
+
+                    interpolatedPixel.channel_at(i) = T(std::lerp(c1, c2, xBias));
+                }
+
+                return interpolatedPixel;
+            }
+
+            std::tie(x, y) = this->bounds_checked_coordinates<BoundsCheckingMode>(x, y);
 
             vond_optional_assert(pixels_, "Tried to access the pixels of a null image.");
             vond_optional_assert(((x < this->width()) && (y < this->height())), "Tried to access an image pixel out of bounds.");
@@ -177,6 +451,72 @@ namespace vond
             return interpolatedPixel;
         }
 
+        // A faster bilinear_sample() for RGBA8 images, for sampling textures per
+        // pixel. Takes the coordinates in 16.16 fixed point (e.g. 1.5 as 0x18000)
+        // and filters all four color channels at once in integer math. Coordinates
+        // are either clamped to the image's edges or, for images whose dimensions
+        // are powers of two, mask-wrapped; the image's own bounds-checking mode is
+        // ignored.
+        template <image_bounds_checking_mode_e BoundsCheckingMode = image_bounds_checking_mode_e::clamped>
+        vond::color<T, NumColorChannels> bilinear_sample_fixed(int32_t x, int32_t y) const
+        {
+            static_assert((std::is_same_v<T, uint8_t> && (NumColorChannels == 4)),
+                          "Fixed-point bilinear sampling is only available for RGBA8 images.");
+
+            static_assert(((BoundsCheckingMode == image_bounds_checking_mode_e::clamped) ||
+                           (BoundsCheckingMode == image_bounds_checking_mode_e::wrapped_pow2)),
+                          "Fixed-point bilinear sampling supports only clamped and mask-wrapped coordinates.");
+
+            vond_optional_assert(pixels_, "Tried to access the pixels of a null image.");
+
+            if constexpr (BoundsCheckingMode == image_bounds_checking_mode_e::wrapped_pow2)
+            {
+                vond_optional_assert(this->is_pow2(), "Mask-wrapping an image whose dimensions aren't powers of two.");
+
+                // The shift floors negative coordinates too, so the texels' indices
+                // wrap correctly on both sides of zero.
+                const unsigned x1 = ((x >> 16) & (this->width() - 1));
+                const unsigned y1 = ((y >> 16) & (this->height() - 1));
+                const unsigned x2 = ((x1 + 1) & (this->width() - 1));
+                const unsigned y2 = ((y1 + 1) & (this->height() - 1));
+
+                return vond::bilinear_blend_rgba8(pixels_[x1 + (y1 * this->width())],
+                                                  pixels_[x2 + (y1 * this->width())],
+                                                  pixels_[x1 + (y2 * this->width())],
+                                                  pixels_[x2 + (y2 * this->width())],
+                                                  ((x >> 8) & 0xff),
+                                                  ((y >> 8) & 0xff));
+            }
+            else
+            {
+                const unsigned width = this->width();
+
+                return vond::bilinear_sample_fixed_clamped(pixels_, width, this->height(), x, y,
+                                                           [width](const unsigned x1, const unsigned y1, unsigned idx[4])
+                                                           {
+                                                               idx[0] = (x1 + (y1 * width));
+                                                               idx[1] = (idx[0] + 1);
+                                                               idx[2] = (idx[0] + width);
+                                                               idx[3] = (idx[2] + 1);
+                                                           });
+            }
+        }
+
+        // Returns a non-owning view of the image's pixels.
+        vond::image_view<T, NumColorChannels> view(void) const
+        {
+            return vond::image_view<T, NumColorChannels>(this->pixels_, this->width(), this->height(), this->width());
+        }
+
+        // Returns a non-owning view of the given rectangle of the image's pixels.
+        vond::image_view<T, NumColorChannels> view(const unsigned x,
+                                                   const unsigned y,
+                                                   const unsigned width,
+                                                   const unsigned height) const
+        {
+            return this->view().subview(x, y, width, height);
+        }
+
         const uint8_t* pixel_array(void) const
         {
             return (uint8_t*)this->pixels_;
@@ -190,7 +530,7 @@ namespace vond
             {
                 for (unsigned x = 0; x < this->width(); x++)
                 {
-                    this->pixel_at(x, y)[channelIdx] = fillValue;
+                    this->pixel_at<image_bounds_checking_mode_e::none>(x, y).channel_at(channelIdx) = fillValue;
                 }
             }
 
@@ -203,7 +543,7 @@ namespace vond
             {
                 for (unsigned x = 0; x < this->width(); x++)
                 {
-                    this->pixel_at(x, y) = fillColor;
+                    this->pixel_at<image_bounds_checking_mode_e::none>(x, y) = fillColor;
                 }
             }
 
@@ -213,18 +553,47 @@ namespace vond
         // Returns the given image coordinates bounds-checked against the image's
         // dimensions. E.g if the image has a resolution of 800 x 600, a y coordinate
         // value of 605 might be returned as 599 (clamped).
-        std::tuple<double, double> bounds_checked_coordinates(double x, double y) const
+        std::tuple<double, double> bounds_checked_coordinates(const double x, const double y) const
         {
             switch (this->boundsCheckingMode)
             {
                 case image_bounds_checking_mode_e::none: return {x, y};
                 case image_bounds_checking_mode_e::wrapped: return this->wrapped_coordinates(x, y);
+                case image_bounds_checking_mode_e::wrapped_pow2: return this->bounds_checked_coordinates<image_bounds_checking_mode_e::wrapped_pow2>(x, y);
                 case image_bounds_checking_mode_e::clamped: return this->clamped_coordinates(x, y);
             }
 
             return this->clamped_coordinates(x, y);
         }
 
+        template <image_bounds_checking_mode_e BoundsCheckingMode>
+        std::tuple<double, double> bounds_checked_coordinates(const double x, const double y) const
+        {
+            if constexpr (BoundsCheckingMode == image_bounds_checking_mode_e::clamped)
+            {
+                return this->clamped_coordinates(x, y);
+            }
+            else if constexpr (BoundsCheckingMode == image_bounds_checking_mode_e::wrapped)
+            {
+                return this->wrapped_coordinates(x, y);
+            }
+            else if constexpr (BoundsCheckingMode == image_bounds_checking_mode_e::wrapped_pow2)
+            {
+                vond_optional_assert(this->is_pow2(), "Mask-wrapping an image whose dimensions aren't powers of two.");
+
+                // Mask the integer part, keep the fraction.
+                const double xFloored = std::floor(x);
+                const double yFloored = std::floor(y);
+
+                return {((x - xFloored) + (int(xFloored) & (this->width() - 1))),
+                        ((y - yFloored) + (int(yFloored) & (this->height() - 1)))};
+            }
+            else
+            {
+                return {x, y};
+            }
+        }
+
         std::tuple<double, double> clamped_coordinates(double x, double y) const
         {
             if (x < 0) x = 0;
@@ -237,20 +606,23 @@ namespace vond
 
         std::tuple<double, double> wrapped_coordinates(double x, double y) const
         {
-            double xw = ((x / (this->width() - 1) - floor(x / (this->width() - 1))) * this->width());
-            double yw = ((y / (this->height() - 1) - floor(y / (this->height() - 1))) * this->height());
+            x -= (floor(x / this->width()) * this->width());
+            y -= (floor(y / this->height()) * this->height());
 
-            return clamped_coordinates(xw, yw);
+            // Guard against rounding error landing a coordinate just below zero on
+            // the image's far edge.
+            return this->clamped_coordinates(x, y);
         }
 
         // Returns a copy of this image but with its values converted into the given
-        // type.
+        // type. The copy's pixel buffer is taken from the given pool, if any.
         template <typename T2, std::size_t NumColorChannels2>
         vond::image<T2, NumColorChannels2> as(const double scale = 1,
                                               const double low = 0,
-                                              const double high = 255) const
+                                              const double high = 255,
+                                              vond::image_buffer_pool *const pool = nullptr) const
         {
-            vond::image<T2, NumColorChannels2> newImage(this->width(), this->height(), this->bpp());
+            vond::image<T2, NumColorChannels2> newImage(this->width(), this->height(), this->bpp(), pool);
 
             for (unsigned y = 0; y < this->height(); y++)
             {
@@ -258,8 +630,8 @@ namespace vond
                 {
                     for (unsigned i = 0; i < NumColorChannels2; i++)
                     {
-                        const double convertedValue = double(this->pixel_at(x, y)[i % NumColorChannels] * scale);
-                        newImage.pixel_at(x, y).channel_at(i) = T2(std::max(low, std::min(high, convertedValue)));
+                        const double convertedValue = double(this->pixel_at<image_bounds_checking_mode_e::none>(x, y)[i % NumColorChannels] * scale);
+                        newImage.template pixel_at<image_bounds_checking_mode_e::none>(x, y).channel_at(i) = T2(std::max(low, std::min(high, convertedValue)));
                     }
                 }
             }
@@ -272,10 +644,19 @@ namespace vond
         image_bounds_checking_mode_e boundsCheckingMode = image_bounds_checking_mode_e::clamped;
 
     private:
-        const unsigned width_;
-        const unsigned height_;
-        const unsigned bpp_;
-        vond::color<T, NumColorChannels> *const pixels_;
+        std::size_t num_bytes(void) const
+        {
+            return (std::size_t(this->width()) * this->height() * sizeof(vond::color<T, NumColorChannels>));
+        }
+
+        unsigned width_;
+        unsigned height_;
+        unsigned bpp_;
+        vond::color<T, NumColorChannels> *pixels_;
+
+        // The pool from which the pixel buffer was taken, or null if it was
+        // allocated directly.
+        vond::image_buffer_pool *pool;
     };
 }
 
@@ -0,0 +1,73 @@
+/*
+ * 2021 Tarpeeksi Hyvae Soft
+ *
+ * Software: Vond
+ *
+ */
+
+#include <cstdlib>
+#include "vond/image_buffer_pool.h"
+#include "vond/assert.h"
+
+void* vond::allocate_image_buffer(const std::size_t numBytes)
+{
+    // std::aligned_alloc() wants the size to be a multiple of the alignment.
+    const std::size_t paddedSize = (((numBytes + IMAGE_BUFFER_ALIGNMENT - 1) / IMAGE_BUFFER_ALIGNMENT) * IMAGE_BUFFER_ALIGNMENT);
+
+    void *const buffer = std::aligned_alloc(IMAGE_BUFFER_ALIGNMENT, paddedSize);
+    vond_assert(buffer, "Failed to allocate an image buffer.");
+
+    return buffer;
+}
+
+void vond::free_image_buffer(void *const buffer)
+{
+    std::free(buffer);
+
+    return;
+}
+
+vond::image_buffer_pool::~image_buffer_pool(void)
+{
+    for (auto &freeBuffer: this->freeBuffers)
+    {
+        vond::free_image_buffer(freeBuffer.second);
+    }
+
+    return;
+}
+
+void* vond::image_buffer_pool::acquire(const std::size_t numBytes)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+
+        const auto freeBuffer = this->freeBuffers.find(numBytes);
+
+        if (freeBuffer != this->freeBuffers.end())
+        {
+            void *const buffer = freeBuffer->second;
+            this->freeBuffers.erase(freeBuffer);
+
+            return buffer;
+        }
+    }
+
+    return vond::allocate_image_buffer(numBytes);
+}
+
+void vond::image_buffer_pool::release(void *const buffer, const std::size_t numBytes)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    this->freeBuffers.insert({numBytes, buffer});
+
+    return;
+}
+
+std::size_t vond::image_buffer_pool::num_free_buffers(void) const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    return this->freeBuffers.size();
+}
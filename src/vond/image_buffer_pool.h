@@ -0,0 +1,58 @@
+/*
+ * 2021 Tarpeeksi Hyvae Soft
+ *
+ * Software: Vond
+ *
+ */
+
+#ifndef VOND_IMAGE_BUFFER_POOL_H
+#define VOND_IMAGE_BUFFER_POOL_H
+
+#include <cstddef>
+#include <unordered_map>
+#include <mutex>
+
+namespace vond
+{
+    // The alignment, in bytes, of image pixel buffers: a cache line, which is
+    // also enough for aligned SIMD loads of up to 512 bits.
+    static const std::size_t IMAGE_BUFFER_ALIGNMENT = 64;
+
+    // Allocates an aligned pixel buffer of at least the given size, or frees one.
+    void* allocate_image_buffer(const std::size_t numBytes);
+    void free_image_buffer(void *const buffer);
+
+    // Keeps the pixel buffers of destroyed images for reuse by images created
+    // later, so that images which are created and destroyed repeatedly - e.g.
+    // per-frame temporaries - needn't go through the system allocator each time.
+    //
+    // Images allocated from a pool return their buffer to it when destroyed, so
+    // the pool must outlive them. Can be shared among threads.
+    class image_buffer_pool
+    {
+    public:
+        image_buffer_pool(void) = default;
+        image_buffer_pool(const image_buffer_pool&) = delete;
+        image_buffer_pool& operator=(const image_buffer_pool&) = delete;
+        ~image_buffer_pool(void);
+
+        // Returns a buffer of the given size, reusing a released one if there
+        // is one of that size.
+        void* acquire(const std::size_t numBytes);
+
+        // Returns to the pool the given buffer, which was acquired from it with
+        // the given size.
+        void release(void *const buffer, const std::size_t numBytes);
+
+        // The number of released buffers waiting for reuse.
+        std::size_t num_free_buffers(void) const;
+
+    private:
+        mutable std::mutex mutex;
+
+        // Released buffers, by size in bytes.
+        std::unordered_multimap<std::size_t, void*> freeBuffers;
+    };
+}
+
+#endif
@@ -0,0 +1,88 @@
+/*
+ * 2021 Tarpeeksi Hyvae Soft
+ *
+ * Software: Vond
+ *
+ */
+
+#ifndef VOND_IMAGE_VIEW_H
+#define VOND_IMAGE_VIEW_H
+
+#include "vond/color.h"
+#include "vond/assert.h"
+
+namespace vond
+{
+    // A non-owning window into the pixels of a vond::image, or into a rectangle of
+    // them. Cheap to create and to copy; the image must outlive the view. Pixel
+    // access isn't bounds-checked, other than by debug assertions.
+    template <typename T, std::size_t NumColorChannels>
+    class image_view
+    {
+    public:
+        // The view's rows are 'stride' pixels apart in memory.
+        image_view(vond::color<T, NumColorChannels> *const pixels,
+                   const unsigned width,
+                   const unsigned height,
+                   const unsigned stride) :
+            pixels(pixels),
+            width_(width),
+            height_(height),
+            stride_(stride)
+        {
+            return;
+        }
+
+        unsigned width(void) const
+        {
+            return this->width_;
+        }
+
+        unsigned height(void) const
+        {
+            return this->height_;
+        }
+
+        unsigned stride(void) const
+        {
+            return this->stride_;
+        }
+
+        // Returns the pixel at the given coordinates relative to the view's top
+        // left corner.
+        vond::color<T, NumColorChannels>& pixel_at(const unsigned x, const unsigned y) const
+        {
+            vond_optional_assert(((x < this->width()) && (y < this->height())), "Tried to access an image view's pixel out of bounds.");
+
+            return this->pixels[x + (y * this->stride())];
+        }
+
+        // Returns the given row's first pixel; the row's pixels follow it in memory.
+        vond::color<T, NumColorChannels>* row(const unsigned y) const
+        {
+            vond_optional_assert((y < this->height()), "Tried to access an image view's row out of bounds.");
+
+            return &this->pixels[y * this->stride()];
+        }
+
+        // Returns a view of the given rectangle of this view's pixels.
+        image_view<T, NumColorChannels> subview(const unsigned x,
+                                                const unsigned y,
+                                                const unsigned width,
+                                                const unsigned height) const
+        {
+            vond_assert((((x + width) <= this->width()) && ((y + height) <= this->height())),
+                        "An image view's subview must be within the view.");
+
+            return image_view<T, NumColorChannels>(&this->pixels[x + (y * this->stride())], width, height, this->stride());
+        }
+
+    private:
+        vond::color<T, NumColorChannels> *pixels;
+        unsigned width_;
+        unsigned height_;
+        unsigned stride_;
+    };
+}
+
+#endif
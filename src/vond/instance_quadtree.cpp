@@ -0,0 +1,236 @@
+/*
+ * 2021 Tarpeeksi Hyvae Soft
+ *
+ * Software: Vond
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include "vond/instance_quadtree.h"
+#include "vond/assert.h"
+
+vond::instance_quadtree::instance_quadtree(const double minX,
+                                           const double minZ,
+                                           const double size,
+                                           const double minY,
+                                           const double maxY,
+                                           const unsigned maxDepth) :
+    minX(minX),
+    minZ(minZ),
+    size_(size),
+    minY(minY),
+    maxY(maxY),
+    maxDepth(maxDepth)
+{
+    vond_assert((size > 0) && (maxY >= minY), "Invalid quadtree bounds.");
+    vond_assert((maxDepth < 16), "Too deep a quadtree.");
+
+    unsigned numNodes = 0;
+
+    for (unsigned depth = 0; depth <= maxDepth; depth++)
+    {
+        this->levelOffsets.push_back(numNodes);
+        numNodes += (1u << (depth * 2));
+    }
+
+    this->nodes.resize(numNodes);
+
+    return;
+}
+
+void vond::instance_quadtree::find_cell(const vond::mesh_instance *const instance,
+                                        unsigned *depth,
+                                        unsigned *cellX,
+                                        unsigned *cellZ) const
+{
+    const vond::vector3<double> center = instance->bounding_center();
+    const double radius = instance->bounding_radius();
+
+    *depth = 0;
+    *cellX = 0;
+    *cellZ = 0;
+
+    // Instances that extend outside the tree's region go into the root.
+    if (((center[1] - radius) < this->minY) ||
+        ((center[1] + radius) > this->maxY) ||
+        (center[0] < this->minX) ||
+        (center[2] < this->minZ) ||
+        (center[0] >= (this->minX + this->size_)) ||
+        (center[2] >= (this->minZ + this->size_)))
+    {
+        return;
+    }
+
+    // A node's bounds extend half a cell past its cell, so an instance fits in a
+    // node if the instance's radius is at most half of the node's cell size.
+    while ((*depth < this->maxDepth) &&
+           (radius <= ((this->size_ / (1u << (*depth + 1))) / 2)))
+    {
+        (*depth)++;
+    }
+
+    const unsigned numCells = (1u << *depth);
+    const double cellSize = (this->size_ / numCells);
+
+    *cellX = std::min((numCells - 1), unsigned((center[0] - this->minX) / cellSize));
+    *cellZ = std::min((numCells - 1), unsigned((center[2] - this->minZ) / cellSize));
+
+    return;
+}
+
+void vond::instance_quadtree::adjust_subtree_counts(const unsigned depth,
+                                                    const unsigned cellX,
+                                                    const unsigned cellZ,
+                                                    const int delta)
+{
+    for (int d = depth; d >= 0; d--)
+    {
+        const unsigned shift = (depth - d);
+        this->nodes[this->node_idx(d, (cellX >> shift), (cellZ >> shift))].numInSubtree += delta;
+    }
+
+    return;
+}
+
+void vond::instance_quadtree::insert(const vond::mesh_instance *const instance)
+{
+    vond_assert(!this->instanceNodes.count(instance), "The instance is already in the quadtree.");
+
+    unsigned depth, cellX, cellZ;
+    this->find_cell(instance, &depth, &cellX, &cellZ);
+
+    const unsigned nodeIdx = this->node_idx(depth, cellX, cellZ);
+
+    this->nodes[nodeIdx].instances.push_back(instance);
+    this->adjust_subtree_counts(depth, cellX, cellZ, 1);
+    this->instanceNodes[instance] = nodeIdx;
+
+    return;
+}
+
+void vond::instance_quadtree::remove(const vond::mesh_instance *const instance)
+{
+    const auto instanceNode = this->instanceNodes.find(instance);
+
+    vond_assert((instanceNode != this->instanceNodes.end()), "The instance isn't in the quadtree.");
+
+    const unsigned nodeIdx = instanceNode->second;
+    std::vector<const vond::mesh_instance*> &nodeInstances = this->nodes[nodeIdx].instances;
+
+    *std::find(nodeInstances.begin(), nodeInstances.end(), instance) = nodeInstances.back();
+    nodeInstances.pop_back();
+
+    // Find the node's depth and cell from its index.
+    {
+        const unsigned depth = (std::upper_bound(this->levelOffsets.begin(), this->levelOffsets.end(), nodeIdx) - this->levelOffsets.begin() - 1);
+        const unsigned levelIdx = (nodeIdx - this->levelOffsets[depth]);
+
+        this->adjust_subtree_counts(depth, (levelIdx & ((1u << depth) - 1)), (levelIdx >> depth), -1);
+    }
+
+    this->instanceNodes.erase(instanceNode);
+
+    return;
+}
+
+void vond::instance_quadtree::update(const vond::mesh_instance *const instance)
+{
+    const auto instanceNode = this->instanceNodes.find(instance);
+
+    vond_assert((instanceNode != this->instanceNodes.end()), "The instance isn't in the quadtree.");
+
+    unsigned depth, cellX, cellZ;
+    this->find_cell(instance, &depth, &cellX, &cellZ);
+
+    // Most moves are small enough not to cross into another node.
+    if (this->node_idx(depth, cellX, cellZ) == instanceNode->second)
+    {
+        return;
+    }
+
+    this->remove(instance);
+    this->insert(instance);
+
+    return;
+}
+
+void vond::instance_quadtree::query(const vond::frustum &frustum,
+                                    std::vector<const vond::mesh_instance*> &dstVisible) const
+{
+    this->query_node(0, 0, 0, false, frustum, dstVisible);
+
+    return;
+}
+
+void vond::instance_quadtree::query_node(const unsigned depth,
+                                         const unsigned cellX,
+                                         const unsigned cellZ,
+                                         bool isInsideFrustum,
+                                         const vond::frustum &frustum,
+                                         std::vector<const vond::mesh_instance*> &dstVisible) const
+{
+    const node_s &node = this->nodes[this->node_idx(depth, cellX, cellZ)];
+
+    if (!node.numInSubtree)
+    {
+        return;
+    }
+
+    // The root may hold instances that are outside its bounds, so its instances
+    // are always tested individually.
+    if (!isInsideFrustum)
+    {
+        const double cellSize = (this->size_ / (1u << depth));
+        const vond::vector3<double> boundsMin = {(this->minX + ((cellX - 0.5) * cellSize)), this->minY, (this->minZ + ((cellZ - 0.5) * cellSize))};
+        const vond::vector3<double> boundsMax = {(this->minX + ((cellX + 1.5) * cellSize)), this->maxY, (this->minZ + ((cellZ + 1.5) * cellSize))};
+
+        switch (frustum.classify_box(boundsMin, boundsMax))
+        {
+            case vond::frustum::containment_e::outside:
+            {
+                if (depth > 0)
+                {
+                    return;
+                }
+
+                // Only the root's own instances can be visible.
+                for (const vond::mesh_instance *const instance: node.instances)
+                {
+                    if (frustum.intersects_sphere(instance->bounding_center(), instance->bounding_radius()))
+                    {
+                        dstVisible.push_back(instance);
+                    }
+                }
+
+                return;
+            }
+            case vond::frustum::containment_e::inside: isInsideFrustum = (depth > 0); break;
+            case vond::frustum::containment_e::partial: break;
+        }
+    }
+
+    for (const vond::mesh_instance *const instance: node.instances)
+    {
+        if (isInsideFrustum ||
+            frustum.intersects_sphere(instance->bounding_center(), instance->bounding_radius()))
+        {
+            dstVisible.push_back(instance);
+        }
+    }
+
+    if (depth < this->maxDepth)
+    {
+        for (unsigned i = 0; i < 4; i++)
+        {
+            this->query_node((depth + 1),
+                             ((cellX * 2) + (i & 1)),
+                             ((cellZ * 2) + (i >> 1)),
+                             isInsideFrustum,
+                             frustum,
+                             dstVisible);
+        }
+    }
+
+    return;
+}
@@ -0,0 +1,111 @@
+/*
+ * 2021 Tarpeeksi Hyvae Soft
+ *
+ * Software: Vond
+ *
+ */
+
+#ifndef VOND_INSTANCE_QUADTREE_H
+#define VOND_INSTANCE_QUADTREE_H
+
+#include <vector>
+#include <unordered_map>
+#include "vond/mesh_instance.h"
+#include "vond/frustum.h"
+
+namespace vond
+{
+    // A loose quadtree over the XZ plane - e.g. over the landscape's heightmap -
+    // for finding the mesh instances that are within the camera's view without
+    // testing each instance individually.
+    //
+    // Each instance is filed in the deepest node whose cell is at least as large
+    // as the instance's bounding sphere, in the cell containing the sphere's center.
+    // A node's bounds extend by half a cell past its cell on every side, so the
+    // node's bounds contain all of its instances and an instance's node depends
+    // only on its size and position. Nodes whose bounds are outside the view are
+    // skipped along with everything below them.
+    //
+    // The tree doesn't own the instances; it refers to them by pointer, so they
+    // must stay where they are while in the tree.
+    class instance_quadtree
+    {
+    public:
+        // The tree covers the square from (minX, minZ) to (minX + size, minZ + size)
+        // on the XZ plane, and heights from minY to maxY. Instances that extend
+        // outside this region are kept in the root node, so are tested against the
+        // view individually.
+        instance_quadtree(const double minX,
+                          const double minZ,
+                          const double size,
+                          const double minY,
+                          const double maxY,
+                          const unsigned maxDepth = 6);
+
+        void insert(const vond::mesh_instance *const instance);
+
+        void remove(const vond::mesh_instance *const instance);
+
+        // Re-files the given instance in the tree. Call after modifying the
+        // instance's transform.
+        void update(const vond::mesh_instance *const instance);
+
+        // Appends to the given vector the instances whose bounding spheres are
+        // within the given frustum.
+        void query(const vond::frustum &frustum, std::vector<const vond::mesh_instance*> &dstVisible) const;
+
+        unsigned size(void) const
+        {
+            return this->instanceNodes.size();
+        }
+
+    private:
+        struct node_s
+        {
+            std::vector<const vond::mesh_instance*> instances;
+
+            // The number of instances in this node and its descendants.
+            unsigned numInSubtree = 0;
+        };
+
+        // Returns the index in the node array of the node for the given cell at the
+        // given depth.
+        unsigned node_idx(const unsigned depth, const unsigned cellX, const unsigned cellZ) const
+        {
+            return (this->levelOffsets[depth] + cellX + (cellZ << depth));
+        }
+
+        // Returns the depth and cell of the node in which the given instance belongs.
+        void find_cell(const vond::mesh_instance *const instance, unsigned *depth, unsigned *cellX, unsigned *cellZ) const;
+
+        // Adds the given amount to the subtree counts of the given node and its
+        // ancestors.
+        void adjust_subtree_counts(const unsigned depth, const unsigned cellX, const unsigned cellZ, const int delta);
+
+        void query_node(const unsigned depth,
+                        const unsigned cellX,
+                        const unsigned cellZ,
+                        const bool isInsideFrustum,
+                        const vond::frustum &frustum,
+                        std::vector<const vond::mesh_instance*> &dstVisible) const;
+
+        const double minX;
+        const double minZ;
+        const double size_;
+        const double minY;
+        const double maxY;
+        const unsigned maxDepth;
+
+        // The nodes of all levels, root first, then the 2 x 2 nodes of level 1, and
+        // so on. Within a level, the nodes are in row-major order.
+        std::vector<node_s> nodes;
+
+        // The index in the node array of each level's first node.
+        std::vector<unsigned> levelOffsets;
+
+        // The node index of each instance in the tree.
+        std::unordered_map<const vond::mesh_instance*, unsigned> instanceNodes;
+    };
+}
+
+#endif
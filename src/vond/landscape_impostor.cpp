@@ -0,0 +1,236 @@
+/*
+ * 2021 Tarpeeksi Hyvae Soft
+ *
+ * Software: Vond
+ *
+ * Renders and samples a cylindrical impostor of a landscape's far field.
+ *
+ */
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "vond/landscape_impostor.h"
+#include "vond/assert.h"
+
+// How far, as a fraction of the impostor's radius, the viewer can move from the
+// center of the impostor before a new impostor is rendered around it.
+static const double RECENTER_DISTANCE = 0.05;
+
+// The distance that rays step through the far field, relative to how far they've
+// traveled.
+static const double RAY_STEP_MULTIPLIER = 0.003;
+
+vond::landscape_impostor::landscape_impostor(const double radius,
+                                             const double maxDistance,
+                                             const unsigned numColumns,
+                                             const unsigned numRows,
+                                             const double maxElevation) :
+    radius_(radius),
+    maxDistance(maxDistance),
+    numColumns(numColumns),
+    numRows(numRows),
+    maxElevation(maxElevation),
+    front(std::make_unique<cylinder_s>(numColumns, numRows)),
+    back(std::make_unique<cylinder_s>(numColumns, numRows))
+{
+    vond_assert((radius > 0) && (maxDistance > radius) && (numRows >= 2), "Invalid impostor dimensions.");
+
+    return;
+}
+
+double vond::landscape_impostor::row_elevation(const unsigned row) const
+{
+    return std::lerp(-this->maxElevation, this->maxElevation, ((row + 0.5) / this->numRows));
+}
+
+void vond::landscape_impostor::update(std::function<vond::color_grayscale<double>(const vond::vector3<double> &samplePosition, const vond::vector3<double> &viewerPosition)> heightmapSampler,
+                                      std::function<vond::color_rgba<uint8_t>(const vond::vector3<double> &samplePosition, const vond::vector3<double> &viewerPosition)> textureSampler,
+                                      const vond::vector3<double> &viewerPosition,
+                                      const unsigned maxNumColumns)
+{
+    // Start rendering a new impostor if the viewer has moved too far from the
+    // current one, or if the current one has been invalidated. An invalidation
+    // also restarts a new impostor that's partway rendered, as its finished
+    // columns may be out of date.
+    if (!this->backIsRendering || this->isInvalidated)
+    {
+        if (this->front->isComplete &&
+            !this->isInvalidated &&
+            (viewerPosition.distance_to(this->front->center) < (this->radius_ * RECENTER_DISTANCE)))
+        {
+            return;
+        }
+
+        this->back->center = viewerPosition;
+        this->back->numColumnsRendered = 0;
+        this->back->isComplete = false;
+        this->backIsRendering = true;
+        this->isInvalidated = false;
+    }
+
+    const unsigned startColumn = this->back->numColumnsRendered;
+    const unsigned endColumn = std::min(this->numColumns, (startColumn + maxNumColumns));
+
+    #pragma omp parallel for
+    for (unsigned column = startColumn; column < endColumn; column++)
+    {
+        this->render_column(heightmapSampler, textureSampler, column);
+    }
+
+    this->back->numColumnsRendered = endColumn;
+
+    if (endColumn == this->numColumns)
+    {
+        this->back->isComplete = true;
+        this->backIsRendering = false;
+
+        std::swap(this->front, this->back);
+    }
+
+    return;
+}
+
+void vond::landscape_impostor::render_column(const std::function<vond::color_grayscale<double>(const vond::vector3<double> &samplePosition, const vond::vector3<double> &viewerPosition)> &heightmapSampler,
+                                             const std::function<vond::color_rgba<uint8_t>(const vond::vector3<double> &samplePosition, const vond::vector3<double> &viewerPosition)> &textureSampler,
+                                             const unsigned column)
+{
+    cylinder_s &cylinder = *this->back;
+
+    const double azimuth = (((column + 0.5) / this->numColumns) * (2 * M_PI));
+
+    // How far the previous (lower) ray got before hitting the terrain. Since the
+    // terrain is a heightmap, the next (higher) ray won't hit it any closer.
+    double distance = this->radius_;
+
+    for (unsigned row = 0; row < this->numRows; row++)
+    {
+        const double elevation = this->row_elevation(row);
+        const vond::vector3<double> dir = {(cos(azimuth) * cos(elevation)),
+                                           sin(elevation),
+                                           (sin(azimuth) * cos(elevation))};
+
+        // The ray's distance is measured along the ground plane, so that all rays
+        // start on the cylinder.
+        const double horizontalScale = (1 / cos(elevation));
+
+        for (; distance < this->maxDistance; distance += std::max(1.0, (distance * RAY_STEP_MULTIPLIER)))
+        {
+            const vond::vector3<double> pos = (cylinder.center + (dir * (distance * horizontalScale)));
+
+            if ((pos[1] > 255) && (dir[1] >= 0))
+            {
+                distance = this->maxDistance;
+                break;
+            }
+
+            if (heightmapSampler(pos, cylinder.center)[0] >= pos[1])
+            {
+                const vond::color_rgba<uint8_t> color = textureSampler(pos, cylinder.center);
+
+                if (!color[3])
+                {
+                    distance = this->maxDistance;
+                    break;
+                }
+
+                cylinder.colors.pixel_at(column, row) = color;
+                cylinder.depths.pixel_at(column, row) = {(distance * horizontalScale)};
+
+                break;
+            }
+        }
+
+        // The ray found no terrain, so neither will any of the rays above it.
+        if (distance >= this->maxDistance)
+        {
+            for (; row < this->numRows; row++)
+            {
+                cylinder.colors.pixel_at(column, row) = {0, 0, 0, 0};
+                cylinder.depths.pixel_at(column, row) = {std::numeric_limits<double>::max()};
+            }
+        }
+    }
+
+    return;
+}
+
+std::tuple<vond::color_rgba<uint8_t>, double> vond::landscape_impostor::sample(const vond::vector3<double> &position,
+                                                                               const vond::vector3<double> &viewerPosition) const
+{
+    const cylinder_s &cylinder = *this->front;
+
+    const vond::vector3<double> dir = (position - cylinder.center);
+    const double horizontalDistance = sqrt((dir[0] * dir[0]) + (dir[2] * dir[2]));
+    const double elevation = atan2(dir[1], horizontalDistance);
+
+    if (elevation >= this->maxElevation)
+    {
+        return {{0, 0, 0, 0}, std::numeric_limits<double>::max()};
+    }
+
+    double azimuth = atan2(dir[2], dir[0]);
+    if (azimuth < 0)
+    {
+        azimuth += (2 * M_PI);
+    }
+
+    // The sample point in texel coordinates, with texel centers at whole numbers.
+    // Columns wrap around the cylinder, and rows are clamped.
+    const double texelX = (((azimuth / (2 * M_PI)) * this->numColumns) - 0.5);
+    const double texelY = std::max(0.0, std::min((this->numRows - 1.0), ((((elevation + this->maxElevation) / (2 * this->maxElevation)) * this->numRows) - 0.5)));
+
+    const int left = int(std::floor(texelX));
+    const int top = std::min(int(texelY), int(this->numRows - 2));
+    const int columns[2] = {int((left + this->numColumns) % this->numColumns),
+                            int((left + 1) % this->numColumns)};
+    const int rows[2] = {top, (top + 1)};
+    const double xFrac = (texelX - left);
+    const double yFrac = (texelY - top);
+
+    const vond::color_rgba<uint8_t> colors[4] = {cylinder.colors.pixel_at(columns[0], rows[0]),
+                                                 cylinder.colors.pixel_at(columns[1], rows[0]),
+                                                 cylinder.colors.pixel_at(columns[0], rows[1]),
+                                                 cylinder.colors.pixel_at(columns[1], rows[1])};
+
+    const double distances[4] = {cylinder.depths.pixel_at(columns[0], rows[0])[0],
+                                 cylinder.depths.pixel_at(columns[1], rows[0])[0],
+                                 cylinder.depths.pixel_at(columns[0], rows[1])[0],
+                                 cylinder.depths.pixel_at(columns[1], rows[1])[0]};
+
+    vond::color_rgba<uint8_t> color;
+    double distance;
+
+    // Blending terrain with the empty texels past its edge would bleed the empty
+    // texels' color into the terrain's silhouette, so there the nearest texel is
+    // taken instead.
+    if (colors[0][3] && colors[1][3] && colors[2][3] && colors[3][3])
+    {
+        color = vond::bilinear_blend_rgba8(colors[0], colors[1], colors[2], colors[3],
+                                           std::min(255u, uint32_t(xFrac * 256)), std::min(255u, uint32_t(yFrac * 256)));
+
+        distance = std::lerp(std::lerp(distances[0], distances[1], xFrac),
+                             std::lerp(distances[2], distances[3], xFrac),
+                             yFrac);
+    }
+    else
+    {
+        const unsigned nearest = (unsigned(xFrac >= 0.5) + (2 * unsigned(yFrac >= 0.5)));
+
+        color = colors[nearest];
+        distance = distances[nearest];
+
+        if (!color[3])
+        {
+            return {{0, 0, 0, 0}, std::numeric_limits<double>::max()};
+        }
+    }
+
+    // The stored distances are from the cylinder's center, so find where along
+    // the line of sight from the center the terrain is, and measure the viewer's
+    // distance to that point, for the depth to agree with the rays that the
+    // viewer traces through the near field.
+    const vond::vector3<double> terrainPosition = (cylinder.center + (dir.normalized() * distance));
+
+    return {color, terrainPosition.distance_to(viewerPosition)};
+}
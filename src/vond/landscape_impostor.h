@@ -0,0 +1,126 @@
+/*
+ * 2021 Tarpeeksi Hyvae Soft
+ *
+ * Software: Vond
+ *
+ */
+
+#ifndef VOND_LANDSCAPE_IMPOSTOR_H
+#define VOND_LANDSCAPE_IMPOSTOR_H
+
+#include <functional>
+#include <memory>
+#include <tuple>
+#include "vond/image.h"
+#include "vond/color.h"
+#include "vond/vector.h"
+
+namespace vond
+{
+    // A cylindrical impostor of the far field of a landscape: the color of the
+    // terrain beyond a given radius around the viewer, and its distance from the
+    // cylinder's center, as seen from the center in a number of azimuth columns by
+    // elevation rows.
+    //
+    // Rays traced by render_landscape() can stop at the cylinder and take their
+    // color from it, so that they needn't march across the far terrain, which
+    // changes little from one frame to the next.
+    //
+    // The impostor is double-buffered: when the viewer moves far enough from the
+    // cylinder's center, a new cylinder is rendered around the viewer's position a
+    // number of columns at a time (see update()), and the old one continues to be
+    // used until the new one is complete. Likewise when the impostor is invalidated,
+    // e.g. because the terrain's lighting has changed (see invalidate()).
+    class landscape_impostor
+    {
+    public:
+        landscape_impostor(const double radius,
+                           const double maxDistance = 4096,
+                           const unsigned numColumns = 2048,
+                           const unsigned numRows = 256,
+                           const double maxElevation = (M_PI / 6));
+
+        // Renders at most the given number of columns of the impostor. Call once
+        // per frame, or with numColumns() columns to build the full impostor at once.
+        void update(std::function<vond::color_grayscale<double>(const vond::vector3<double> &samplePosition, const vond::vector3<double> &viewerPosition)> heightmapSampler,
+                    std::function<vond::color_rgba<uint8_t>(const vond::vector3<double> &samplePosition, const vond::vector3<double> &viewerPosition)> textureSampler,
+                    const vond::vector3<double> &viewerPosition,
+                    const unsigned maxNumColumns);
+
+        // Returns the color of the far field at the given position on (or past) the
+        // impostor's cylinder, and the distance from the given viewer position to
+        // the terrain there. The far field is sampled bilinearly, except along the
+        // edges of the terrain, where it's sampled as nearest. Where the far field
+        // has no terrain, the color's alpha channel will be 0.
+        std::tuple<vond::color_rgba<uint8_t>, double> sample(const vond::vector3<double> &position,
+                                                             const vond::vector3<double> &viewerPosition) const;
+
+        // Marks the impostor as out of date, so that update() renders a new one
+        // even if the viewer hasn't moved. Call when something that the impostor's
+        // samplers depend on - e.g. the sun's direction or the terrain's lighting -
+        // has changed.
+        void invalidate(void)
+        {
+            this->isInvalidated = true;
+
+            return;
+        }
+
+        // Returns true if the impostor has been fully rendered at least once, and
+        // can be sampled.
+        bool is_ready(void) const
+        {
+            return this->front->isComplete;
+        }
+
+        double radius(void) const
+        {
+            return this->radius_;
+        }
+
+        unsigned num_columns(void) const
+        {
+            return this->numColumns;
+        }
+
+    private:
+        struct cylinder_s
+        {
+            cylinder_s(const unsigned numColumns, const unsigned numRows) :
+                colors(numColumns, numRows, 32),
+                depths(numColumns, numRows, 32)
+            {
+                return;
+            }
+
+            vond::image<uint8_t, 4> colors;
+            vond::image<double, 1> depths;
+            vond::vector3<double> center = {0, 0, 0};
+            unsigned numColumnsRendered = 0;
+            bool isComplete = false;
+        };
+
+        void render_column(const std::function<vond::color_grayscale<double>(const vond::vector3<double> &samplePosition, const vond::vector3<double> &viewerPosition)> &heightmapSampler,
+                           const std::function<vond::color_rgba<uint8_t>(const vond::vector3<double> &samplePosition, const vond::vector3<double> &viewerPosition)> &textureSampler,
+                           const unsigned column);
+
+        double row_elevation(const unsigned row) const;
+
+        const double radius_;
+        const double maxDistance;
+        const unsigned numColumns;
+        const unsigned numRows;
+        const double maxElevation;
+
+        // The cylinder being sampled, and the one being rendered.
+        std::unique_ptr<cylinder_s> front;
+        std::unique_ptr<cylinder_s> back;
+        bool backIsRendering = false;
+
+        // Whether the front cylinder has been invalidated since the back one began
+        // rendering.
+        bool isInvalidated = false;
+    };
+}
+
+#endif
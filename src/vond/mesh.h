@@ -0,0 +1,95 @@
+/*
+ * 2021 Tarpeeksi Hyvae Soft
+ *
+ * Software: Vond
+ *
+ */
+
+#ifndef VOND_MESH_H
+#define VOND_MESH_H
+
+#include <vector>
+#include <algorithm>
+#include "vond/triangle.h"
+#include "vond/vector.h"
+
+namespace vond
+{
+    // An indexed triangle mesh. The mesh's unique vertices are stored once each,
+    // with their attributes as structure of arrays - one array per attribute - so
+    // that they can be transformed in batches with SIMD. The triangles refer to
+    // the vertices by index, so vertices shared by several triangles needn't be
+    // transformed more than once.
+    struct mesh
+    {
+        unsigned num_triangles(void) const
+        {
+            return this->materialIndices.size();
+        }
+
+        unsigned num_vertices(void) const
+        {
+            return this->x.size();
+        }
+
+        // The vertex buffer.
+        std::vector<double> x;
+        std::vector<double> y;
+        std::vector<double> z;
+        std::vector<double> u;
+        std::vector<double> v;
+
+        // The index buffer: for triangle n, the indices of its three vertices are
+        // at 3n, 3n+1 and 3n+2.
+        std::vector<uint32_t> indices;
+
+        // For each triangle, the index of its material in the material table.
+        std::vector<uint16_t> materialIndices;
+
+        // The mesh's materials, shared among its triangles.
+        std::vector<vond::triangle_material> materials;
+
+        // A sphere, in object space, that encloses all of the mesh's vertices.
+        // Call update_bounding_sphere() after modifying the vertices.
+        vond::vector3<double> boundingCenter = {0, 0, 0};
+        double boundingRadius = 0;
+
+        // Progressively simplified versions of the mesh, from the most detailed to
+        // the least, for drawing the mesh when it's small on screen. Empty if the
+        // mesh has no levels of detail (see vond::generate_lods()).
+        std::vector<vond::mesh> lods;
+
+        // For a level of detail, how far, in object space, its surface may deviate
+        // from the original mesh's. Zero for the original.
+        double lodError = 0;
+
+        void update_bounding_sphere(void)
+        {
+            if (!this->num_vertices())
+            {
+                return;
+            }
+
+            // Center the sphere on the vertices' bounding box.
+            vond::vector3<double> min = {this->x[0], this->y[0], this->z[0]};
+            vond::vector3<double> max = min;
+            for (unsigned i = 0; i < this->num_vertices(); i++)
+            {
+                min = {std::min(min[0], this->x[i]), std::min(min[1], this->y[i]), std::min(min[2], this->z[i])};
+                max = {std::max(max[0], this->x[i]), std::max(max[1], this->y[i]), std::max(max[2], this->z[i])};
+            }
+
+            this->boundingCenter = ((min + max) * 0.5);
+            this->boundingRadius = 0;
+            for (unsigned i = 0; i < this->num_vertices(); i++)
+            {
+                this->boundingRadius = std::max(this->boundingRadius,
+                                                this->boundingCenter.distance_to({this->x[i], this->y[i], this->z[i]}));
+            }
+
+            return;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,56 @@
+/*
+ * 2021 Tarpeeksi Hyvae Soft
+ *
+ * Software: Vond
+ *
+ */
+
+#ifndef VOND_MESH_INSTANCE_H
+#define VOND_MESH_INSTANCE_H
+
+#include <cmath>
+#include <algorithm>
+#include "vond/mesh.h"
+#include "vond/matrix.h"
+#include "vond/vector.h"
+
+namespace vond
+{
+    // A placement of a mesh in the world. Any number of instances can share the
+    // same mesh.
+    struct mesh_instance
+    {
+        const vond::mesh *mesh = nullptr;
+
+        // Transforms the mesh from object space into world space.
+        vond::matrix44 transform = vond::identity_matrix();
+
+        // Returns the center of the mesh's bounding sphere in world space.
+        vond::vector3<double> bounding_center(void) const
+        {
+            const vond::vector3<double> &c = this->mesh->boundingCenter;
+            const vond::matrix44 &m = this->transform;
+
+            return {((m(0, 0) * c[0]) + (m(0, 1) * c[1]) + (m(0, 2) * c[2]) + m(0, 3)),
+                    ((m(1, 0) * c[0]) + (m(1, 1) * c[1]) + (m(1, 2) * c[2]) + m(1, 3)),
+                    ((m(2, 0) * c[0]) + (m(2, 1) * c[1]) + (m(2, 2) * c[2]) + m(2, 3))};
+        }
+
+        // Returns the radius of the mesh's bounding sphere in world space, i.e.
+        // scaled by the transform's largest scaling factor.
+        double bounding_radius(void) const
+        {
+            const vond::matrix44 &m = this->transform;
+            double maxScaleSq = 0;
+
+            for (unsigned j = 0; j < 3; j++)
+            {
+                maxScaleSq = std::max(maxScaleSq, ((m(0, j) * m(0, j)) + (m(1, j) * m(1, j)) + (m(2, j) * m(2, j))));
+            }
+
+            return (this->mesh->boundingRadius * sqrt(maxScaleSq));
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,516 @@
+/*
+ * 2021 Tarpeeksi Hyvae Soft
+ *
+ * Software: Vond
+ *
+ * Simplifies triangle meshes by quadric error edge collapse.
+ *
+ */
+
+#include <map>
+#include <tuple>
+#include <queue>
+#include <cmath>
+#include <algorithm>
+#include "vond/mesh_simplify.h"
+#include "vond/assert.h"
+
+// LODs aren't generated below this many triangles.
+static const unsigned MIN_LOD_TRIANGLES = 8;
+
+// LOD generation stops when a level can't be simplified to below this fraction of
+// the previous level's triangles.
+static const double MIN_LOD_REDUCTION = 0.8;
+
+// The sum of the squared distances of a point from a set of planes, as a
+// symmetric 4 x 4 matrix: for point p, error(p) = p^T * Q * p, with p[3] = 1.
+struct quadric_s
+{
+    // The upper triangle of the matrix, row by row.
+    double q[10] = {0};
+
+    static quadric_s from_plane(const double a, const double b, const double c, const double d)
+    {
+        quadric_s quadric;
+
+        quadric.q[0] = (a * a); quadric.q[1] = (a * b); quadric.q[2] = (a * c); quadric.q[3] = (a * d);
+                                quadric.q[4] = (b * b); quadric.q[5] = (b * c); quadric.q[6] = (b * d);
+                                                        quadric.q[7] = (c * c); quadric.q[8] = (c * d);
+                                                                                quadric.q[9] = (d * d);
+
+        return quadric;
+    }
+
+    quadric_s& operator+=(const quadric_s &other)
+    {
+        for (unsigned i = 0; i < 10; i++)
+        {
+            this->q[i] += other.q[i];
+        }
+
+        return *this;
+    }
+
+    double error_at(const double x, const double y, const double z) const
+    {
+        return ((this->q[0] * x * x) + (2 * this->q[1] * x * y) + (2 * this->q[2] * x * z) + (2 * this->q[3] * x) +
+                (this->q[4] * y * y) + (2 * this->q[5] * y * z) + (2 * this->q[6] * y) +
+                (this->q[7] * z * z) + (2 * this->q[8] * z) +
+                this->q[9]);
+    }
+};
+
+// A candidate collapse of vertex 'from' into vertex 'to'.
+struct collapse_s
+{
+    double error;
+    uint32_t from;
+    uint32_t to;
+
+    // The versions of the vertices' quadrics when the collapse was evaluated. If
+    // either has since changed, so has the collapse's error.
+    unsigned fromVersion;
+    unsigned toVersion;
+
+    bool operator>(const collapse_s &other) const
+    {
+        return (this->error > other.error);
+    }
+};
+
+// The working state of a mesh being simplified.
+struct simplifier_s
+{
+    simplifier_s(const vond::mesh &mesh) :
+        mesh(mesh),
+        indices(mesh.indices),
+        isTriangleAlive(mesh.num_triangles(), true),
+        numAliveTriangles(mesh.num_triangles()),
+        isVertexAlive(mesh.num_vertices(), true),
+        isVertexLocked(mesh.num_vertices(), false),
+        vertexTriangles(mesh.num_vertices()),
+        positionIdx(mesh.num_vertices())
+    {
+        // Vertices that share a position - i.e. that differ only in their u,v
+        // coordinates - share a quadric.
+        {
+            std::map<std::tuple<double, double, double>, uint32_t> knownPositions;
+
+            for (uint32_t v = 0; v < mesh.num_vertices(); v++)
+            {
+                const auto [knownPosition, isNew] = knownPositions.insert({{mesh.x[v], mesh.y[v], mesh.z[v]}, uint32_t(this->positionVertices.size())});
+
+                if (isNew)
+                {
+                    this->positionVertices.emplace_back();
+                }
+
+                this->positionIdx[v] = knownPosition->second;
+                this->positionVertices[knownPosition->second].push_back(v);
+            }
+
+            this->quadrics.resize(this->positionVertices.size());
+            this->quadricVersions.resize(this->positionVertices.size(), 0);
+        }
+
+        for (uint32_t t = 0; t < mesh.num_triangles(); t++)
+        {
+            for (unsigned i = 0; i < 3; i++)
+            {
+                this->vertexTriangles[this->indices[(t * 3) + i]].push_back(t);
+            }
+
+            double a, b, c, d;
+            if (!this->triangle_plane(t, &a, &b, &c, &d))
+            {
+                continue;
+            }
+
+            const quadric_s planeQuadric = quadric_s::from_plane(a, b, c, d);
+
+            for (unsigned i = 0; i < 3; i++)
+            {
+                this->quadrics[this->positionIdx[this->indices[(t * 3) + i]]] += planeQuadric;
+            }
+        }
+
+        // Lock the vertices on UV seams and on open borders. An edge is on an open
+        // border if only one triangle uses it.
+        {
+            std::map<std::pair<uint32_t, uint32_t>, unsigned> edgeUseCounts;
+
+            for (uint32_t t = 0; t < mesh.num_triangles(); t++)
+            {
+                for (unsigned i = 0; i < 3; i++)
+                {
+                    const uint32_t p1 = this->positionIdx[this->indices[(t * 3) + i]];
+                    const uint32_t p2 = this->positionIdx[this->indices[(t * 3) + ((i + 1) % 3)]];
+
+                    edgeUseCounts[{std::min(p1, p2), std::max(p1, p2)}]++;
+                }
+            }
+
+            for (const auto &[edge, useCount]: edgeUseCounts)
+            {
+                if (useCount == 1)
+                {
+                    for (const uint32_t v: this->positionVertices[edge.first]) this->isVertexLocked[v] = true;
+                    for (const uint32_t v: this->positionVertices[edge.second]) this->isVertexLocked[v] = true;
+                }
+            }
+
+            for (uint32_t v = 0; v < mesh.num_vertices(); v++)
+            {
+                if (this->positionVertices[this->positionIdx[v]].size() > 1)
+                {
+                    this->isVertexLocked[v] = true;
+                }
+            }
+        }
+
+        return;
+    }
+
+    // Gets the given triangle's plane, with a unit normal. Returns false if the
+    // triangle is degenerate.
+    bool triangle_plane(const uint32_t t, double *a, double *b, double *c, double *d) const
+    {
+        const vond::vector3<double> p0 = this->position(this->indices[(t * 3) + 0]);
+        const vond::vector3<double> p1 = this->position(this->indices[(t * 3) + 1]);
+        const vond::vector3<double> p2 = this->position(this->indices[(t * 3) + 2]);
+        const vond::vector3<double> normal = (p1 - p0).cross(p2 - p0);
+        // (length() gives the squared length.)
+        const double length = std::sqrt(normal.length());
+
+        if (length <= 0)
+        {
+            return false;
+        }
+
+        *a = (normal[0] / length);
+        *b = (normal[1] / length);
+        *c = (normal[2] / length);
+        *d = -((*a * p0[0]) + (*b * p0[1]) + (*c * p0[2]));
+
+        return true;
+    }
+
+    vond::vector3<double> position(const uint32_t v) const
+    {
+        return {this->mesh.x[v], this->mesh.y[v], this->mesh.z[v]};
+    }
+
+    // Queues up the collapses of the given vertex into each of its neighbors and
+    // vice versa.
+    void queue_collapses(const uint32_t v)
+    {
+        for (const uint32_t t: this->vertexTriangles[v])
+        {
+            for (unsigned i = 0; i < 3; i++)
+            {
+                const uint32_t neighbor = this->indices[(t * 3) + i];
+
+                if (neighbor != v)
+                {
+                    this->queue_collapse(v, neighbor);
+                    this->queue_collapse(neighbor, v);
+                }
+            }
+        }
+
+        return;
+    }
+
+    void queue_collapse(const uint32_t from, const uint32_t to)
+    {
+        if (this->isVertexLocked[from])
+        {
+            return;
+        }
+
+        const uint32_t fromPos = this->positionIdx[from];
+        const uint32_t toPos = this->positionIdx[to];
+
+        quadric_s quadric = this->quadrics[fromPos];
+        quadric += this->quadrics[toPos];
+
+        this->collapses.push({std::max(0.0, quadric.error_at(this->mesh.x[to], this->mesh.y[to], this->mesh.z[to])),
+                              from,
+                              to,
+                              this->quadricVersions[fromPos],
+                              this->quadricVersions[toPos]});
+
+        return;
+    }
+
+    // Returns true if the given collapse would leave the mesh intact: it mustn't
+    // flip any triangle over, nor fold two of the 'from' vertex's triangles onto
+    // each other.
+    bool is_collapse_valid(const uint32_t from, const uint32_t to) const
+    {
+        const uint32_t toPos = this->positionIdx[to];
+        const vond::vector3<double> toPosition = this->position(to);
+
+        for (const uint32_t t: this->vertexTriangles[from])
+        {
+            const uint32_t *const tri = &this->indices[t * 3];
+            bool isAdjacentToTarget = false;
+
+            for (unsigned i = 0; i < 3; i++)
+            {
+                if (this->positionIdx[tri[i]] == toPos)
+                {
+                    // Triangles that join 'from' to another copy of 'to' would
+                    // end up with the wrong u,v coordinates.
+                    if (tri[i] != to)
+                    {
+                        return false;
+                    }
+
+                    isAdjacentToTarget = true;
+                }
+            }
+
+            // Triangles on the collapsed edge are removed.
+            if (isAdjacentToTarget)
+            {
+                continue;
+            }
+
+            vond::vector3<double> p[3];
+            for (unsigned i = 0; i < 3; i++)
+            {
+                p[i] = ((tri[i] == from)? toPosition : this->position(tri[i]));
+            }
+
+            double a, b, c, d;
+            this->triangle_plane(t, &a, &b, &c, &d);
+
+            const vond::vector3<double> newNormal = (p[1] - p[0]).cross(p[2] - p[0]);
+            const double newNormalLength = std::sqrt(newNormal.length());
+
+            // Reject collapses that leave a triangle flipped or nearly degenerate.
+            if ((newNormalLength <= 0) ||
+                (((newNormal[0] * a) + (newNormal[1] * b) + (newNormal[2] * c)) < (0.2 * newNormalLength)))
+            {
+                return false;
+            }
+        }
+
+        // The vertices 'from' and 'to' may have only the two vertices opposite
+        // their shared edge as common neighbors; otherwise, the collapse would
+        // pinch the mesh.
+        {
+            std::vector<uint32_t> fromNeighbors, toNeighbors;
+
+            const auto gather_neighbors = [this](const uint32_t v, std::vector<uint32_t> &neighbors)
+            {
+                for (const uint32_t t: this->vertexTriangles[v])
+                {
+                    for (unsigned i = 0; i < 3; i++)
+                    {
+                        neighbors.push_back(this->positionIdx[this->indices[(t * 3) + i]]);
+                    }
+                }
+
+                std::sort(neighbors.begin(), neighbors.end());
+                neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+
+                return;
+            };
+
+            gather_neighbors(from, fromNeighbors);
+            gather_neighbors(to, toNeighbors);
+
+            unsigned numSharedTriangles = 0;
+            for (const uint32_t t: this->vertexTriangles[from])
+            {
+                numSharedTriangles += ((this->positionIdx[this->indices[(t * 3) + 0]] == toPos) ||
+                                       (this->positionIdx[this->indices[(t * 3) + 1]] == toPos) ||
+                                       (this->positionIdx[this->indices[(t * 3) + 2]] == toPos));
+            }
+
+            std::vector<uint32_t> commonNeighbors;
+            std::set_intersection(fromNeighbors.begin(), fromNeighbors.end(),
+                                  toNeighbors.begin(), toNeighbors.end(),
+                                  std::back_inserter(commonNeighbors));
+
+            // The common neighbors include 'from' and 'to' themselves.
+            if ((commonNeighbors.size() - 2) != numSharedTriangles)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void collapse(const uint32_t from, const uint32_t to)
+    {
+        const uint32_t toPos = this->positionIdx[to];
+
+        for (const uint32_t t: this->vertexTriangles[from])
+        {
+            uint32_t *const tri = &this->indices[t * 3];
+
+            if ((tri[0] == to) || (tri[1] == to) || (tri[2] == to))
+            {
+                this->isTriangleAlive[t] = false;
+                this->numAliveTriangles--;
+
+                for (unsigned i = 0; i < 3; i++)
+                {
+                    if (tri[i] != from)
+                    {
+                        std::vector<uint32_t> &triangles = this->vertexTriangles[tri[i]];
+                        triangles.erase(std::find(triangles.begin(), triangles.end(), t));
+                    }
+                }
+            }
+            else
+            {
+                *std::find(tri, (tri + 3), from) = to;
+                this->vertexTriangles[to].push_back(t);
+            }
+        }
+
+        this->vertexTriangles[from].clear();
+        this->isVertexAlive[from] = false;
+
+        this->quadrics[toPos] += this->quadrics[this->positionIdx[from]];
+        this->quadricVersions[toPos]++;
+
+        for (const uint32_t v: this->positionVertices[toPos])
+        {
+            if (this->isVertexAlive[v])
+            {
+                this->queue_collapses(v);
+            }
+        }
+
+        return;
+    }
+
+    const vond::mesh &mesh;
+
+    std::vector<uint32_t> indices;
+    std::vector<bool> isTriangleAlive;
+    unsigned numAliveTriangles;
+
+    std::vector<bool> isVertexAlive;
+    std::vector<bool> isVertexLocked;
+
+    // For each vertex, the alive triangles that use it.
+    std::vector<std::vector<uint32_t>> vertexTriangles;
+
+    // For each vertex, the index of its position among the mesh's unique positions,
+    // and for each position, the vertices at it.
+    std::vector<uint32_t> positionIdx;
+    std::vector<std::vector<uint32_t>> positionVertices;
+
+    // For each unique position, the quadric of the planes of the triangles that
+    // have been collapsed into it, and a count of the times it's been modified.
+    std::vector<quadric_s> quadrics;
+    std::vector<unsigned> quadricVersions;
+
+    std::priority_queue<collapse_s, std::vector<collapse_s>, std::greater<collapse_s>> collapses;
+};
+
+vond::mesh vond::simplify_mesh(const vond::mesh &mesh, const unsigned targetNumTriangles)
+{
+    simplifier_s simplifier(mesh);
+
+    for (uint32_t v = 0; v < mesh.num_vertices(); v++)
+    {
+        simplifier.queue_collapses(v);
+    }
+
+    double maxError = 0;
+
+    while ((simplifier.numAliveTriangles > targetNumTriangles) &&
+           !simplifier.collapses.empty())
+    {
+        const collapse_s collapse = simplifier.collapses.top();
+        simplifier.collapses.pop();
+
+        if (!simplifier.isVertexAlive[collapse.from] ||
+            !simplifier.isVertexAlive[collapse.to] ||
+            (collapse.fromVersion != simplifier.quadricVersions[simplifier.positionIdx[collapse.from]]) ||
+            (collapse.toVersion != simplifier.quadricVersions[simplifier.positionIdx[collapse.to]]) ||
+            !simplifier.is_collapse_valid(collapse.from, collapse.to))
+        {
+            continue;
+        }
+
+        simplifier.collapse(collapse.from, collapse.to);
+        maxError = std::max(maxError, collapse.error);
+    }
+
+    // Copy the remaining triangles and the vertices they use into a new mesh.
+    vond::mesh simplified;
+    {
+        std::vector<uint32_t> newVertexIdx(mesh.num_vertices(), ~0u);
+
+        for (uint32_t t = 0; t < mesh.num_triangles(); t++)
+        {
+            if (!simplifier.isTriangleAlive[t])
+            {
+                continue;
+            }
+
+            for (unsigned i = 0; i < 3; i++)
+            {
+                const uint32_t v = simplifier.indices[(t * 3) + i];
+
+                if (newVertexIdx[v] == ~0u)
+                {
+                    newVertexIdx[v] = simplified.num_vertices();
+
+                    simplified.x.push_back(mesh.x[v]);
+                    simplified.y.push_back(mesh.y[v]);
+                    simplified.z.push_back(mesh.z[v]);
+                    simplified.u.push_back(mesh.u[v]);
+                    simplified.v.push_back(mesh.v[v]);
+                }
+
+                simplified.indices.push_back(newVertexIdx[v]);
+            }
+
+            simplified.materialIndices.push_back(mesh.materialIndices[t]);
+        }
+
+        simplified.materials = mesh.materials;
+
+        // Keep the original's bounds, so that the mesh is culled the same
+        // regardless of its level of detail.
+        simplified.boundingCenter = mesh.boundingCenter;
+        simplified.boundingRadius = mesh.boundingRadius;
+
+        // The quadric error is a sum of squared distances from planes, so its
+        // square root bounds the distance from any one of them.
+        simplified.lodError = (mesh.lodError + std::sqrt(maxError));
+    }
+
+    return simplified;
+}
+
+std::vector<vond::mesh> vond::generate_lods(const vond::mesh &mesh)
+{
+    std::vector<vond::mesh> lods;
+    const vond::mesh *previous = &mesh;
+
+    while ((previous->num_triangles() / 2) >= MIN_LOD_TRIANGLES)
+    {
+        vond::mesh lod = vond::simplify_mesh(*previous, (previous->num_triangles() / 2));
+
+        if (lod.num_triangles() > (previous->num_triangles() * MIN_LOD_REDUCTION))
+        {
+            break;
+        }
+
+        lods.push_back(lod);
+        previous = &lods.back();
+    }
+
+    return lods;
+}
@@ -0,0 +1,34 @@
+/*
+ * 2021 Tarpeeksi Hyvae Soft
+ *
+ * Software: Vond
+ *
+ */
+
+#ifndef VOND_MESH_SIMPLIFY_H
+#define VOND_MESH_SIMPLIFY_H
+
+#include <vector>
+#include "vond/mesh.h"
+
+namespace vond
+{
+    // Returns a copy of the given mesh reduced to at most the given number of
+    // triangles, or to as few as it can be without visibly breaking it. Edges are
+    // collapsed in order of least quadric error (Garland & Heckbert), each into one
+    // of its existing vertices, so the simplified mesh's vertices - including their
+    // u,v coordinates - are a subset of the original's. Vertices on UV seams and
+    // open borders stay put, so the mesh's texturing and outline are preserved.
+    //
+    // The returned mesh's lodError gives how far its surface may deviate from the
+    // given mesh's, in object space, as estimated from the collapses' quadric
+    // errors. The given mesh's own lodError is added to it.
+    vond::mesh simplify_mesh(const vond::mesh &mesh, const unsigned targetNumTriangles);
+
+    // Returns a chain of progressively simplified versions of the given mesh, each
+    // with about half the triangles of the previous one, for use as the mesh's
+    // levels of detail (see vond::mesh::lods).
+    std::vector<vond::mesh> generate_lods(const vond::mesh &mesh);
+}
+
+#endif
@@ -50,82 +50,94 @@ static vond::vector3<double> get_barycentric_coords(const vond::triangle &t, con
             (u[0] * invZ)};
 }
 
-// Precomputes and returns for the given triangle and screen rectangle certain
+// Precomputes and returns for the given triangle and clip rectangle certain
 // parameters that will be needed during rendering of the triangle.
 static precomputed_params_s get_precomputed_parameters(const vond::triangle &tri,
-                                                       const vond::rect<int> &screenRect)
+                                                       const vond::rect<int> &clipRect)
 {
     precomputed_params_s params = {};
 
-    params.boundingRect = vond::rect<int>::from_triangle(tri).clipped_against(screenRect);
+    const vond::rect<int> triRect = vond::rect<int>::from_triangle(tri);
 
-    params.isVisible = ((params.boundingRect.width() > 0) &&
-                        (params.boundingRect.height() > 0));
+    params.boundingRect = triRect.clipped_against(clipRect);
+
+    params.isVisible = ((params.boundingRect.width() >= 0) &&
+                        (params.boundingRect.height() >= 0));
 
     if (!params.isVisible)
     {
         return params;
     }
 
-    params.isSubPixelSize = ((params.boundingRect.width() == 1) &&
-                             (params.boundingRect.height() == 1));
+    params.isSubPixelSize = ((triRect.width() <= 1) &&
+                             (triRect.height() <= 1));
 
-    // Interpolate barycentric coordinates over the triangle's bounding box.
+    // Step barycentric coordinates over the triangle's bounding box. Since they
+    // vary linearly across the screen, the per-pixel steps are exact.
     {
         const vond::vector3<double> bcTopLeft = get_barycentric_coords(tri, params.boundingRect.left(), params.boundingRect.top());
-        const vond::vector3<double> bcTopRight = get_barycentric_coords(tri, params.boundingRect.right(), params.boundingRect.top());
-        const vond::vector3<double> bcBotLeft = get_barycentric_coords(tri, params.boundingRect.left(), params.boundingRect.bottom());
-
-        const double sX = (1.0 / params.boundingRect.width());
-        const double sY = (1.0 / params.boundingRect.height());
-
-        params.xStep = vond::vector3<double>{std::lerp(bcTopLeft[0], bcTopRight[0], sX),
-                                             std::lerp(bcTopLeft[1], bcTopRight[1], sX),
-                                             std::lerp(bcTopLeft[2], bcTopRight[2], sX)} - bcTopLeft;
-
-        params.yStep = vond::vector3<double>{std::lerp(bcTopLeft[0], bcBotLeft[0], sY),
-                                             std::lerp(bcTopLeft[1], bcBotLeft[1], sY),
-                                             std::lerp(bcTopLeft[2], bcBotLeft[2], sY)} - bcTopLeft;
+        const vond::vector3<double> bcTopRight = get_barycentric_coords(tri, (params.boundingRect.left() + 1), params.boundingRect.top());
+        const vond::vector3<double> bcBotLeft = get_barycentric_coords(tri, params.boundingRect.left(), (params.boundingRect.top() + 1));
 
+        params.xStep = (bcTopRight - bcTopLeft);
+        params.yStep = (bcBotLeft - bcTopLeft);
         params.topLeft = bcTopLeft;
     }
 
     return params;
 }
 
-void vond::rasterize_triangle::barycentric(const vond::triangle &tri,
-                                           vond::image<uint8_t, 4> &dstPixelmap,
-                                           vond::image<double, 1> &dstDepthmap)
+unsigned vond::rasterize_triangle::barycentric(const vond::triangle &tri,
+                                               const vond::triangle_material &material,
+                                               vond::image<uint8_t, 4> &dstPixelmap,
+                                               vond::image<double, 1> &dstDepthmap,
+                                               const vond::rect<int> &clipRect)
 {
-    const precomputed_params_s precomputedParams = get_precomputed_parameters(tri, vond::rect<int>{{0, 0}, {int(dstPixelmap.width()), int(dstPixelmap.height())}});
+    const precomputed_params_s precomputedParams = get_precomputed_parameters(tri, clipRect);
 
     if (!precomputedParams.isVisible)
     {
-        return;
+        return 0;
     }
 
-    // Some triangles get sub-pixel small, so just draw them as single pixels.
+    // Some triangles get sub-pixel small, so just draw them as single pixels. The
+    // pixel is picked from the unclipped bounding rect, so that a triangle that
+    // straddles the edge of the clip rect is drawn at the same pixel whichever
+    // clip rect it's drawn into - i.e. only in the one that contains the pixel.
     if (precomputedParams.isSubPixelSize)
     {
         double depth = ((tri.v[0].position[2] + tri.v[1].position[2] + tri.v[2].position[2]) / 3.0);
 
-        int x = precomputedParams.boundingRect.left();
-        int y = precomputedParams.boundingRect.top();
+        const vond::rect<int> triRect = vond::rect<int>::from_triangle(tri);
+        const int x = triRect.left();
+        const int y = triRect.top();
+
+        if ((x < clipRect.left()) ||
+            (x > clipRect.right()) ||
+            (y < clipRect.top()) ||
+            (y > clipRect.bottom()))
+        {
+            return 0;
+        }
 
         if (depth < dstDepthmap.pixel_at(x, y)[0])
         {
-            const double u = (((tri.v[0].uv[0] + tri.v[1].uv[0] + tri.v[2].uv[0]) / 3.0) * tri.material.texture->width());
-            const double v = (((tri.v[0].uv[1] + tri.v[1].uv[1] + tri.v[2].uv[1]) / 3.0) * tri.material.texture->height());
+            const double u = ((tri.v[0].uv[0] + tri.v[1].uv[0] + tri.v[2].uv[0]) / 3.0);
+            const double v = ((tri.v[0].uv[1] + tri.v[1].uv[1] + tri.v[2].uv[1]) / 3.0);
 
-            dstPixelmap.pixel_at(x, y) = tri.material.texture
-                                         ? tri.material.texture->bilinear_sample(u, v)
-                                         : tri.material.baseColor;
+            dstPixelmap.pixel_at(x, y) = material.texture
+                                         ? material.texture->sample(u, v, 0)
+                                         : material.baseColor;
             dstDepthmap.pixel_at(x, y) = {depth};
+
+            return 1;
         }
 
-        return;
+        return 0;
     }
 
+    unsigned numDrawn = 0;
+
     // Draw all pixels that fall within the triangle's surface.
     {
         #define BARY_INTERPOLATE(TRI_PARAM) ((tri.v[0].TRI_PARAM * xPos[0]) +\
@@ -165,11 +177,14 @@ void vond::rasterize_triangle::barycentric(const vond::triangle &tri,
 
                 if (depth < dstDepthmap.pixel_at(x, y)[0])
                 {
-                    const double u = (BARY_INTERPOLATE(uv[0]) * tri.material.texture->width());
-                    const double v = (BARY_INTERPOLATE(uv[1]) * tri.material.texture->height());
+                    const double u = BARY_INTERPOLATE(uv[0]);
+                    const double v = BARY_INTERPOLATE(uv[1]);
 
-                    dstPixelmap.pixel_at(x, y) = tri.material.texture->bilinear_sample(u, v);
+                    dstPixelmap.pixel_at(x, y) = material.texture
+                                                 ? material.texture->sample(u, v, 0)
+                                                 : material.baseColor;
                     dstDepthmap.pixel_at(x, y) = {depth};
+                    numDrawn++;
                 }
             }
         }
@@ -177,5 +192,5 @@ void vond::rasterize_triangle::barycentric(const vond::triangle &tri,
         #undef BARY_INTERPOLATE
     }
 
-    return;
+    return numDrawn;
 }
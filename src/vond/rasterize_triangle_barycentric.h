@@ -11,14 +11,19 @@
 #include <stdint.h>
 #include "vond/triangle.h"
 #include "vond/image.h"
+#include "vond/rect.h"
 
 namespace vond::rasterize_triangle
 {
     // Rasterizes the given triangle into the given pixel map using barycentric
-    // coordinate-based rendering.
-    void barycentric(const vond::triangle &tri,
-                     vond::image<uint8_t, 4> &dstPixelmap,
-                     vond::image<double, 1> &dstDepthmap);
+    // coordinate-based rendering. Only pixels within the given clip rectangle
+    // (edges inclusive) are drawn. Returns the number of pixels drawn, i.e. that
+    // passed the depth test.
+    unsigned barycentric(const vond::triangle &tri,
+                         const vond::triangle_material &material,
+                         vond::image<uint8_t, 4> &dstPixelmap,
+                         vond::image<double, 1> &dstDepthmap,
+                         const vond::rect<int> &clipRect);
 }
 
 #endif
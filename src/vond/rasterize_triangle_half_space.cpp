@@ -0,0 +1,298 @@
+/*
+ * 2021 Tarpeeksi Hyvae Soft
+ *
+ * Software: Vond
+ *
+ * A half-space triangle rasterizer. The triangle's three edge functions are set
+ * up in fixed-point with sub-pixel precision, and the triangle's bounding box is
+ * then walked in square blocks of pixels. Blocks entirely outside an edge are
+ * skipped, blocks entirely inside all edges are filled without per-pixel edge
+ * tests, and the rest are tested per pixel. Within a block, the coverage and
+ * depth tests for a row of pixels are evaluated together, in a form that the
+ * compiler can vectorize. Depth is interpolated perspective-correctly per pixel,
+ * the same as in the scanline rasterizer, so that the two agree on the depth of
+ * a surface. Texture coordinates are made perspective-correct at the ends of each
+ * block row and interpolated affinely between.
+ *
+ */
+
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include "vond/rasterize_triangle_half_space.h"
+#include "vond/triangle.h"
+#include "vond/image.h"
+#include "vond/rect.h"
+
+// The number of fractional bits in the fixed-point vertex coordinates.
+static const int SUBPIXEL_BITS = 4;
+static const double SUBPIXEL_SCALE = (1 << SUBPIXEL_BITS);
+
+// The width and height, in pixels, of the blocks in which the triangle is walked.
+static const int BLOCK_SIZE = 8;
+
+// Triangles with vertices farther than this many pixels from the screen's origin
+// are skipped, as their edge functions might overflow.
+static const double MAX_COORDINATE = (1 << 20);
+
+// An edge function, E(x, y) = (a * x) + (b * y) + c, evaluated at pixel x, y. Its
+// value is non-negative for pixels on the inner side of the edge.
+struct edge_s
+{
+    int64_t a;
+    int64_t b;
+    int64_t c;
+
+    int64_t at(const int x, const int y) const
+    {
+        return ((this->a * x) + (this->b * y) + this->c);
+    }
+};
+
+// Returns the edge function for the triangle edge from vertex A to vertex B, given
+// in fixed-point.
+static edge_s make_edge(const int64_t ax, const int64_t ay, const int64_t bx, const int64_t by)
+{
+    edge_s edge;
+
+    edge.a = (-(by - ay) * SUBPIXEL_SCALE);
+    edge.b = ((bx - ax) * SUBPIXEL_SCALE);
+    edge.c = (((by - ay) * ax) - ((bx - ax) * ay));
+
+    // Fill rule: pixels exactly on an edge belong to the triangle only if the edge
+    // is a top or left edge; so that pixels shared by adjacent triangles are drawn
+    // only once.
+    const bool isTopLeft = ((edge.a > 0) || ((edge.a == 0) && (edge.b > 0)));
+    if (!isTopLeft)
+    {
+        edge.c -= 1;
+    }
+
+    return edge;
+}
+
+// A vertex attribute as a plane over the screen: f(x, y) = base + (dx * x) + (dy * y).
+struct attribute_plane_s
+{
+    double base;
+    double dx;
+    double dy;
+
+    double at(const int x, const int y) const
+    {
+        return (this->base + (this->dx * x) + (this->dy * y));
+    }
+};
+
+static attribute_plane_s make_attribute_plane(const double x[3], const double y[3],
+                                              const double f0, const double f1, const double f2)
+{
+    const double x10 = (x[1] - x[0]);
+    const double y10 = (y[1] - y[0]);
+    const double x20 = (x[2] - x[0]);
+    const double y20 = (y[2] - y[0]);
+    const double invDet = (1 / ((x10 * y20) - (x20 * y10)));
+
+    attribute_plane_s plane;
+
+    plane.dx = ((((f1 - f0) * y20) - ((f2 - f0) * y10)) * invDet);
+    plane.dy = ((((f2 - f0) * x10) - ((f1 - f0) * x20)) * invDet);
+    plane.base = (f0 - (plane.dx * x[0]) - (plane.dy * y[0]));
+
+    return plane;
+}
+
+unsigned vond::rasterize_triangle::half_space(const vond::triangle &tri,
+                                              const vond::triangle_material &material,
+                                              vond::image<uint8_t, 4> &dstPixelmap,
+                                              vond::image<double, 1> &dstDepthmap,
+                                              const vond::rect<int> &clipRect)
+{
+    for (unsigned i = 0; i < 3; i++)
+    {
+        if ((std::abs(tri.v[i].position[0]) > MAX_COORDINATE) ||
+            (std::abs(tri.v[i].position[1]) > MAX_COORDINATE))
+        {
+            return 0;
+        }
+    }
+
+    const vond::vertex *v[3] = {&tri.v[0], &tri.v[1], &tri.v[2]};
+
+    // Snap the vertices to the sub-pixel grid.
+    int64_t fx[3], fy[3];
+    for (unsigned i = 0; i < 3; i++)
+    {
+        fx[i] = std::llround(v[i]->position[0] * SUBPIXEL_SCALE);
+        fy[i] = std::llround(v[i]->position[1] * SUBPIXEL_SCALE);
+    }
+
+    // Make the winding consistent, so that the inside of every edge is on the
+    // same side.
+    {
+        const int64_t area = (((fx[1] - fx[0]) * (fy[2] - fy[0])) - ((fy[1] - fy[0]) * (fx[2] - fx[0])));
+
+        if (area == 0)
+        {
+            return 0;
+        }
+
+        if (area < 0)
+        {
+            std::swap(v[1], v[2]);
+            std::swap(fx[1], fx[2]);
+            std::swap(fy[1], fy[2]);
+        }
+    }
+
+    const edge_s edges[3] = {make_edge(fx[1], fy[1], fx[2], fy[2]),
+                             make_edge(fx[2], fy[2], fx[0], fy[0]),
+                             make_edge(fx[0], fy[0], fx[1], fy[1])};
+
+    const vond::rect<int> boundingRect = vond::rect<int>::from_triangle(tri).clipped_against(clipRect);
+
+    if ((boundingRect.width() < 0) ||
+        (boundingRect.height() < 0))
+    {
+        return 0;
+    }
+
+    const vond::texture *const texture = material.texture;
+
+    // The attributes are interpolated perspective-correctly: divided by w, they
+    // vary linearly across the screen. Their planes are set up over the snapped
+    // vertices, so that they agree with the edge functions.
+    attribute_plane_s depthPlane, invWPlane, uPlane, vPlane;
+    {
+        double x[3], y[3];
+        for (unsigned i = 0; i < 3; i++)
+        {
+            x[i] = (fx[i] / SUBPIXEL_SCALE);
+            y[i] = (fy[i] / SUBPIXEL_SCALE);
+        }
+
+        depthPlane = make_attribute_plane(x, y, (v[0]->position[2] / v[0]->w), (v[1]->position[2] / v[1]->w), (v[2]->position[2] / v[2]->w));
+        invWPlane = make_attribute_plane(x, y, (1 / v[0]->w), (1 / v[1]->w), (1 / v[2]->w));
+        uPlane = make_attribute_plane(x, y, (v[0]->uv[0] / v[0]->w), (v[1]->uv[0] / v[1]->w), (v[2]->uv[0] / v[2]->w));
+        vPlane = make_attribute_plane(x, y, (v[0]->uv[1] / v[0]->w), (v[1]->uv[1] / v[1]->w), (v[2]->uv[1] / v[2]->w));
+    }
+
+    unsigned numDrawn = 0;
+
+    for (int blockY = boundingRect.top(); blockY <= boundingRect.bottom(); blockY += BLOCK_SIZE)
+    {
+        const int blockBottom = std::min((blockY + BLOCK_SIZE - 1), boundingRect.bottom());
+
+        for (int blockX = boundingRect.left(); blockX <= boundingRect.right(); blockX += BLOCK_SIZE)
+        {
+            const int blockRight = std::min((blockX + BLOCK_SIZE - 1), boundingRect.right());
+            const int blockWidth = ((blockRight - blockX) + 1);
+
+            // Classify the block by its corners against each edge. Since the edge
+            // functions are linear, a block whose corners are all outside an edge
+            // is entirely outside it, and likewise for inside.
+            bool isFullyCovered = true;
+            {
+                bool isRejected = false;
+
+                for (const edge_s &edge: edges)
+                {
+                    const int64_t c0 = edge.at(blockX, blockY);
+                    const int64_t c1 = edge.at(blockRight, blockY);
+                    const int64_t c2 = edge.at(blockX, blockBottom);
+                    const int64_t c3 = edge.at(blockRight, blockBottom);
+
+                    if ((c0 & c1 & c2 & c3) < 0)
+                    {
+                        isRejected = true;
+                        break;
+                    }
+
+                    if ((c0 | c1 | c2 | c3) < 0)
+                    {
+                        isFullyCovered = false;
+                    }
+                }
+
+                if (isRejected)
+                {
+                    continue;
+                }
+            }
+
+            // The block's mip level, from the rate at which the texture coordinates
+            // change at the block's corner.
+            unsigned mipLevel = 0;
+            if (texture)
+            {
+                const double w = (1 / invWPlane.at(blockX, blockY));
+                const double texU = (uPlane.at(blockX, blockY) * w);
+                const double texV = (vPlane.at(blockX, blockY) * w);
+
+                mipLevel = texture->level_for(((uPlane.dx - (texU * invWPlane.dx)) * w),
+                                              ((vPlane.dx - (texV * invWPlane.dx)) * w),
+                                              ((uPlane.dy - (texU * invWPlane.dy)) * w),
+                                              ((vPlane.dy - (texV * invWPlane.dy)) * w));
+            }
+
+            for (int y = blockY; y <= blockBottom; y++)
+            {
+                double *const depthRow = &dstDepthmap.pixel_at<vond::image_bounds_checking_mode_e::none>(blockX, y).channel[0];
+                vond::color_rgba<uint8_t> *const pixelRow = &dstPixelmap.pixel_at<vond::image_bounds_checking_mode_e::none>(blockX, y);
+
+                const int64_t e0 = edges[0].at(blockX, y);
+                const int64_t e1 = edges[1].at(blockX, y);
+                const int64_t e2 = edges[2].at(blockX, y);
+                const double depthOverW0 = depthPlane.at(blockX, y);
+                const double invW0 = invWPlane.at(blockX, y);
+
+                bool isDrawn[BLOCK_SIZE];
+                double depths[BLOCK_SIZE];
+
+                // Coverage and depth test for the row's pixels.
+                #pragma omp simd
+                for (int i = 0; i < blockWidth; i++)
+                {
+                    const bool isInside = (isFullyCovered ||
+                                           (((e0 + (edges[0].a * i)) |
+                                             (e1 + (edges[1].a * i)) |
+                                             (e2 + (edges[2].a * i))) >= 0));
+
+                    depths[i] = ((depthOverW0 + (depthPlane.dx * i)) / (invW0 + (invWPlane.dx * i)));
+                    isDrawn[i] = (isInside && (depths[i] < depthRow[i]));
+                }
+
+                // The perspective-correct texture coordinates at the row's ends,
+                // interpolated affinely between.
+                double rowU = 0, rowV = 0, uStep = 0, vStep = 0;
+                if (texture)
+                {
+                    const double startW = (1 / invWPlane.at(blockX, y));
+                    const double endW = (1 / invWPlane.at((blockX + blockWidth), y));
+
+                    rowU = (uPlane.at(blockX, y) * startW);
+                    rowV = (vPlane.at(blockX, y) * startW);
+                    uStep = (((uPlane.at((blockX + blockWidth), y) * endW) - rowU) / blockWidth);
+                    vStep = (((vPlane.at((blockX + blockWidth), y) * endW) - rowV) / blockWidth);
+                }
+
+                // Shade the pixels that passed.
+                for (int i = 0; i < blockWidth; i++)
+                {
+                    if (!isDrawn[i])
+                    {
+                        continue;
+                    }
+
+                    pixelRow[i] = texture
+                                  ? texture->sample((rowU + (uStep * i)), (rowV + (vStep * i)), mipLevel)
+                                  : material.baseColor;
+                    depthRow[i] = depths[i];
+                    numDrawn++;
+                }
+            }
+        }
+    }
+
+    return numDrawn;
+}
@@ -0,0 +1,29 @@
+/*
+ * 2021 Tarpeeksi Hyvae Soft
+ *
+ * Software: Vond
+ *
+ */
+
+#ifndef RASTERIZER_HALF_SPACE_H
+#define RASTERIZER_HALF_SPACE_H
+
+#include <stdint.h>
+#include "vond/triangle.h"
+#include "vond/image.h"
+#include "vond/rect.h"
+
+namespace vond::rasterize_triangle
+{
+    // Rasterizes the given triangle into the given pixel map by evaluating its
+    // edge functions in fixed-point over blocks of pixels. Only pixels within the
+    // given clip rectangle (edges inclusive) are drawn. Returns the number of
+    // pixels drawn, i.e. that passed the depth test.
+    unsigned half_space(const vond::triangle &tri,
+                        const vond::triangle_material &material,
+                        vond::image<uint8_t, 4> &dstPixelmap,
+                        vond::image<double, 1> &dstDepthmap,
+                        const vond::rect<int> &clipRect);
+}
+
+#endif
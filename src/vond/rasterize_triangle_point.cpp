@@ -0,0 +1,71 @@
+/*
+ * 2021 Tarpeeksi Hyvae Soft
+ *
+ * Software: Vond
+ *
+ */
+
+#include <cmath>
+#include <algorithm>
+#include "vond/rasterize_triangle_point.h"
+#include "vond/triangle.h"
+#include "vond/image.h"
+#include "vond/rect.h"
+
+unsigned vond::rasterize_triangle::point(const vond::triangle &tri,
+                                         const vond::triangle_material &material,
+                                         vond::image<uint8_t, 4> &dstPixelmap,
+                                         vond::image<double, 1> &dstDepthmap,
+                                         const vond::rect<int> &clipRect)
+{
+    const vond::vector2<int> pixel = vond::rasterize_triangle::point_pixel(tri);
+    const int x = pixel[0];
+    const int y = pixel[1];
+
+    if ((x < clipRect.left()) ||
+        (x > clipRect.right()) ||
+        (y < clipRect.top()) ||
+        (y > clipRect.bottom()))
+    {
+        return 0;
+    }
+
+    const double depth = ((tri.v[0].position[2] + tri.v[1].position[2] + tri.v[2].position[2]) / 3.0);
+
+    if (depth < dstDepthmap.pixel_at<vond::image_bounds_checking_mode_e::none>(x, y)[0])
+    {
+        const vond::texture *const texture = material.texture;
+
+        if (texture)
+        {
+            const double u = ((tri.v[0].uv[0] + tri.v[1].uv[0] + tri.v[2].uv[0]) / 3.0);
+            const double v = ((tri.v[0].uv[1] + tri.v[1].uv[1] + tri.v[2].uv[1]) / 3.0);
+
+            // The triangle spans about a pixel, so its extent in u,v approximates
+            // how much of the texture a pixel spans.
+            const unsigned level = texture->level_for((std::max({tri.v[0].uv[0], tri.v[1].uv[0], tri.v[2].uv[0]}) -
+                                                       std::min({tri.v[0].uv[0], tri.v[1].uv[0], tri.v[2].uv[0]})),
+                                                      (std::max({tri.v[0].uv[1], tri.v[1].uv[1], tri.v[2].uv[1]}) -
+                                                       std::min({tri.v[0].uv[1], tri.v[1].uv[1], tri.v[2].uv[1]})),
+                                                      0, 0);
+
+            dstPixelmap.pixel_at<vond::image_bounds_checking_mode_e::none>(x, y) = texture->sample(u, v, level);
+        }
+        else
+        {
+            dstPixelmap.pixel_at<vond::image_bounds_checking_mode_e::none>(x, y) = material.baseColor;
+        }
+
+        dstDepthmap.pixel_at<vond::image_bounds_checking_mode_e::none>(x, y) = {depth};
+
+        return 1;
+    }
+
+    return 0;
+}
+
+vond::vector2<int> vond::rasterize_triangle::point_pixel(const vond::triangle &tri)
+{
+    return {int(std::round((tri.v[0].position[0] + tri.v[1].position[0] + tri.v[2].position[0]) / 3.0)),
+            int(std::round((tri.v[0].position[1] + tri.v[1].position[1] + tri.v[2].position[1]) / 3.0))};
+}
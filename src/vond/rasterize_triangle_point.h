@@ -0,0 +1,35 @@
+/*
+ * 2021 Tarpeeksi Hyvae Soft
+ *
+ * Software: Vond
+ *
+ */
+
+#ifndef RASTERIZER_POINT_H
+#define RASTERIZER_POINT_H
+
+#include <stdint.h>
+#include "vond/triangle.h"
+#include "vond/image.h"
+#include "vond/rect.h"
+
+namespace vond::rasterize_triangle
+{
+    // Rasterizes the given triangle into the given pixel map as a single pixel at
+    // the triangle's centroid. Meant for triangles no larger than about a pixel,
+    // for which the other rasterizers' setup costs more than the drawing. The
+    // pixel is drawn only if it's within the given clip rectangle (edges inclusive).
+    // Returns the number of pixels drawn, i.e. that passed the depth test.
+    unsigned point(const vond::triangle &tri,
+                   const vond::triangle_material &material,
+                   vond::image<uint8_t, 4> &dstPixelmap,
+                   vond::image<double, 1> &dstDepthmap,
+                   const vond::rect<int> &clipRect);
+
+    // Returns the XY coordinates of the pixel at which point() draws the given
+    // triangle; e.g. for finding which of a number of clip rectangles the
+    // triangle is drawn in.
+    vond::vector2<int> point_pixel(const vond::triangle &tri);
+}
+
+#endif
@@ -6,219 +6,231 @@
  */
 
 #include <cstdlib>
+#include <cmath>
+#include <algorithm>
 #include "vond/rasterize_triangle_scanline.h"
 #include "vond/triangle.h"
 #include "vond/image.h"
 
-// Parameters to be interpolated - during rendering - vertically along triangle
-// edges and horizontally along pixel spans.
-struct interpolation_params_s
-{
-    double startX;
-    double u;
-    double v;
-    double invW;
-    double depth;
-
-    // Increments all parameters by the given deltas.
-    // Note: Assumes that all params are of type double, and that there are as
-    // many left-side params/deltas as right-side params/deltas.
-    void increment(const interpolation_params_s &deltas, const unsigned times = 1)
-    {
-        const unsigned numParams = (sizeof(interpolation_params_s) / sizeof(double));
+// The number of fractional bits in the fixed-point vertex coordinates.
+static const int SUBPIXEL_BITS = 4;
+static const int64_t SUBPIXEL_SCALE = (1 << SUBPIXEL_BITS);
 
-        double *val = (double*)this;
-        double *delta = (double*)&deltas;
+// Triangles with vertices farther than this many pixels from the screen's origin
+// are skipped, as their fixed-point edge stepping might overflow.
+static const double MAX_COORDINATE = (1 << 20);
 
-        for (unsigned i = 0; i < numParams; i++)
-        {
-            *val += (*delta * times);
+// The number of pixels in the groups in which spans are filled. The texture
+// coordinates are made perspective-correct once per group and interpolated
+// affinely between; depth is made perspective-correct per pixel.
+static const int SPAN_GROUP_SIZE = 8;
 
-            val++;
-            delta++;
-        }
-    }
-};
+// Rounds the given division toward negative/positive infinity. Expects the
+// divisor to be positive.
+static int64_t floor_div(const int64_t a, const int64_t b)
+{
+    return ((a / b) - (((a % b) != 0) && (a < 0)));
+}
+
+static int64_t ceil_div(const int64_t a, const int64_t b)
+{
+    return -floor_div(-a, b);
+}
 
-static void fill_triangle_row(const unsigned row,
-                              const interpolation_params_s &rowLeftParams,
-                              const interpolation_params_s &rowRightParams,
-                              const vond::triangle_material &triangleMaterial,
-                              vond::image<uint8_t, 4> &dstPixelmap,
-                              vond::image<double, 1> &dstDepthmap)
+// Steps along a triangle edge one pixel row at a time, giving on each row the
+// first pixel whose center is at or to the right of the edge. The edge's x
+// coordinate is tracked exactly, as a whole number of pixels plus a fractional
+// remainder, so no error accumulates while stepping.
+struct edge_stepper_s
 {
-    if (rowRightParams.startX < rowLeftParams.startX)
+    // Sets the stepper up for the edge from A to B, given in fixed-point (with B
+    // below A), starting on the given pixel row.
+    edge_stepper_s(const int64_t ax, const int64_t ay,
+                   const int64_t bx, const int64_t by,
+                   const int startRow)
     {
+        const int64_t dx = (bx - ax);
+        const int64_t dy = (by - ay);
+
+        // On pixel row y, the edge's x coordinate in pixels is the fraction
+        // (numerator / denominator), with the numerator growing by (dx * scale)
+        // per row.
+        const int64_t numerator = ((ax * dy) + (((startRow * SUBPIXEL_SCALE) - ay) * dx));
+        const int64_t numeratorStep = (dx * SUBPIXEL_SCALE);
+
+        this->denominator = (dy * SUBPIXEL_SCALE);
+        this->x = ceil_div(numerator, this->denominator);
+        this->remainder = ((this->x * this->denominator) - numerator);
+        this->wholeStep = floor_div(numeratorStep, this->denominator);
+        this->fractionStep = (numeratorStep - (this->wholeStep * this->denominator));
+
         return;
     }
 
-    interpolation_params_s currentParams, endingParams, paramDeltas;
-
-    // Establish interpolation parameters.
+    void step(void)
     {
-        currentParams = rowLeftParams;
-        endingParams = rowRightParams;
+        this->x += this->wholeStep;
+        this->remainder -= this->fractionStep;
 
-        const double rowWidth = ((rowRightParams.startX - rowLeftParams.startX) + 1);
-        const auto make_param_deltas = [=](const auto current, const auto end)
+        if (this->remainder < 0)
         {
-            return ((end - current) / rowWidth);
-        };
+            this->remainder += this->denominator;
+            this->x++;
+        }
 
-        paramDeltas.u = make_param_deltas(currentParams.u, endingParams.u);
-        paramDeltas.v = make_param_deltas(currentParams.v, endingParams.v);
-        paramDeltas.depth = make_param_deltas(currentParams.depth, endingParams.depth);
-        paramDeltas.invW = make_param_deltas(currentParams.invW, endingParams.invW);
+        return;
     }
 
-    // Bounds-check: clip against screen edges.
-    {
-        if (currentParams.startX < 0)
-        {
-            const unsigned diff = abs(currentParams.startX);
+    int64_t x;
+    int64_t remainder;
+    int64_t denominator;
+    int64_t wholeStep;
+    int64_t fractionStep;
+};
 
-            currentParams.increment(paramDeltas, diff);
-            currentParams.startX = 0;
-        }
+// A vertex attribute as a plane over the screen: f(x, y) = base + (dx * x) + (dy * y).
+struct attribute_plane_s
+{
+    double base;
+    double dx;
+    double dy;
 
-        if (endingParams.startX >= int(dstPixelmap.width()))
-        {
-            endingParams.startX = (dstPixelmap.width() - 1);
-        }
+    double at(const double x, const double y) const
+    {
+        return (this->base + (this->dx * x) + (this->dy * y));
     }
+};
 
-    // Draw the row.
-    for (int x = currentParams.startX; x <= endingParams.startX; x++)
-    {
-        const double depth = (currentParams.depth / currentParams.invW);
+static attribute_plane_s make_attribute_plane(const double x[3], const double y[3],
+                                              const double f0, const double f1, const double f2)
+{
+    const double x10 = (x[1] - x[0]);
+    const double y10 = (y[1] - y[0]);
+    const double x20 = (x[2] - x[0]);
+    const double y20 = (y[2] - y[0]);
+    const double invDet = (1 / ((x10 * y20) - (x20 * y10)));
 
-        if (dstDepthmap.pixel_at(x, row)[0] > depth)
-        {
-            const double u = ((currentParams.u / currentParams.invW) * triangleMaterial.texture->width());
-            const double v = ((currentParams.v / currentParams.invW) * triangleMaterial.texture->height());
-            const vond::color<uint8_t, 4> color = triangleMaterial.texture
-                                          ? triangleMaterial.texture->bilinear_sample(u, v)
-                                          : triangleMaterial.baseColor;
-
-            dstPixelmap.pixel_at(x, row) = color;
-            dstDepthmap.pixel_at(x, row) = {depth};
-        }
+    attribute_plane_s plane;
 
-        currentParams.increment(paramDeltas);
-    }
+    plane.dx = ((((f1 - f0) * y20) - ((f2 - f0) * y10)) * invDet);
+    plane.dy = ((((f2 - f0) * x10) - ((f1 - f0) * x20)) * invDet);
+    plane.base = (f0 - (plane.dx * x[0]) - (plane.dy * y[0]));
 
-    return;
+    return plane;
 }
 
-// Pixel-fills the corresponding triangle on screen formed by the three given vertices.
-// Expects the vertices to be in screen space, and that the base vertices are level on
-// the y axis (you'd first split your triangle along y, then submit the two pieces to
-// this function individually).
-//
-static void fill_split_triangle(const vond::vertex *peak,
-                                const vond::vertex *base1,
-                                const vond::vertex *base2,
-                                const vond::triangle_material &triangleMaterial,
-                                vond::image<uint8_t, 4> &dstPixelmap,
-                                vond::image<double, 1> &dstDepthmap)
+// The planes of the attributes interpolated across the triangle. Each attribute
+// is divided by the vertex's W, so that it varies linearly in screen space.
+struct interpolation_planes_s
 {
-    vond_assert((base1->position[1] == base2->position[1]),
-             "The software triangle filler was given a malformed triangle. Expected a flat base.");
+    attribute_plane_s invW;
+    attribute_plane_s u;
+    attribute_plane_s v;
+    attribute_plane_s depth;
+};
 
-    // Values to be interpolated vertically as we render the triangle.
-    interpolation_params_s paramsLeft, paramsRight, deltasLeft, deltasRight;
+// Draws the pixels from left to right (inclusive) on the given row. Returns the
+// number of pixels drawn.
+static unsigned fill_span(const int row,
+                          const int left,
+                          const int right,
+                          const interpolation_planes_s &planes,
+                          const vond::triangle_material &triangleMaterial,
+                          vond::image<uint8_t, 4> &dstPixelmap,
+                          vond::image<double, 1> &dstDepthmap)
+{
+    const vond::texture *const texture = triangleMaterial.texture;
 
-    // Whether the triangle peak is above or below the base, in screen space.
-    bool isDownTri = false;
+    double *const depthRow = &dstDepthmap.pixel_at<vond::image_bounds_checking_mode_e::none>(0, row).channel[0];
+    vond::color_rgba<uint8_t> *const pixelRow = &dstPixelmap.pixel_at<vond::image_bounds_checking_mode_e::none>(0, row);
 
-    // Figure out which corner of the base is on the left/right in screen space.
-    const vond::vertex *leftVert = base2;
-    const vond::vertex *rightVert = base1;
-    if (base1->position[0] < base2->position[0])
-    {
-        leftVert = base1;
-        rightVert = base2;
-    }
+    // The perspective-correct attribute values at the start of the current group.
+    double groupStartW = (1 / planes.invW.at(left, row));
+    double groupStartU = (planes.u.at(left, row) * groupStartW);
+    double groupStartV = (planes.v.at(left, row) * groupStartW);
 
-    // The top and bottom y coordinates of the triangle.
-    int startRow = peak->position[1];
-    int endRow = base1->position[1];
+    unsigned numDrawn = 0;
 
-    // Detect whether the triangle is the top or bottom half of the split.
-    if (startRow > endRow)
+    for (int x = left; x <= right; x += SPAN_GROUP_SIZE)
     {
-        isDownTri = true;
+        const int groupLength = std::min(SPAN_GROUP_SIZE, ((right - x) + 1));
 
-        std::swap(startRow, endRow);
+        const double groupEndW = (1 / planes.invW.at((x + groupLength), row));
+        const double groupEndU = (planes.u.at((x + groupLength), row) * groupEndW);
+        const double groupEndV = (planes.v.at((x + groupLength), row) * groupEndW);
 
-        // Don't draw the base row twice; i.e. skip it for the down-triangle.
-        startRow++;
-    }
-    // If the triangle is very thin vertically, don't bother drawing it.
-    else if ((startRow == endRow) ||
-             (endRow - startRow) <= 0)
-    {
-        return;
-    }
+        const double uStep = ((groupEndU - groupStartU) / groupLength);
+        const double vStep = ((groupEndV - groupStartV) / groupLength);
 
-    // Establish interpolation parameters.
-    {
-        const double triHeight = ((endRow - startRow) + 1);
-        const auto make_params = [=](const auto start, const auto end, const bool invertParams)
+        bool isDrawn[SPAN_GROUP_SIZE];
+
+        // Depth-test the group's pixels, and store the depths of those that pass.
+        // Depth is made perspective-correct per pixel rather than per group, the
+        // same as in the half-space rasterizer, so that the two agree on the depth
+        // of a surface.
+        const double depthOverW0 = planes.depth.at(x, row);
+        const double invW0 = planes.invW.at(x, row);
+
+        #pragma omp simd
+        for (int i = 0; i < groupLength; i++)
         {
-            return invertParams
-                   ? std::tuple<double, double>{end, ((start - end) / triHeight)}
-                   : std::tuple<double, double>{start, ((end - start) / triHeight)};
-        };
+            const double depth = ((depthOverW0 + (planes.depth.dx * i)) / (invW0 + (planes.invW.dx * i)));
 
-        std::tie(paramsLeft.invW, deltasLeft.invW) = make_params((1 / leftVert->w), (1 / peak->w), !isDownTri);
-        std::tie(paramsRight.invW, deltasRight.invW) = make_params((1 / rightVert->w), (1 / peak->w), !isDownTri);
-        std::tie(paramsLeft.startX, deltasLeft.startX) = make_params(leftVert->position[0], peak->position[0], !isDownTri);
-        std::tie(paramsRight.startX, deltasRight.startX) = make_params(rightVert->position[0], peak->position[0], !isDownTri);
-        std::tie(paramsLeft.u, deltasLeft.u) = make_params((leftVert->uv[0] / leftVert->w), (peak->uv[0] / peak->w), !isDownTri);
-        std::tie(paramsLeft.v, deltasLeft.v) = make_params((leftVert->uv[1] / leftVert->w), (peak->uv[1] / peak->w), !isDownTri);
-        std::tie(paramsRight.u, deltasRight.u) = make_params((rightVert->uv[0] / rightVert->w), (peak->uv[0] / peak->w), !isDownTri);
-        std::tie(paramsRight.v, deltasRight.v) = make_params((rightVert->uv[1] / rightVert->w), (peak->uv[1] / peak->w), !isDownTri);
-        std::tie(paramsLeft.depth, deltasLeft.depth) = make_params((leftVert->position[2] / leftVert->w), (peak->position[2] / peak->w), !isDownTri);
-        std::tie(paramsRight.depth, deltasRight.depth) = make_params((rightVert->position[2] / rightVert->w), (peak->position[2] / peak->w), !isDownTri);
-    }
+            isDrawn[i] = (depth < depthRow[x + i]);
+            depthRow[x + i] = (isDrawn[i]? depth : depthRow[x + i]);
+        }
 
-    // Bounds-check to make sure we're not going to draw outside of the screen area
-    // horizontally.
-    if (startRow < 0)
-    {
-        paramsLeft.increment(deltasLeft, abs(startRow));
-        paramsRight.increment(deltasRight, abs(startRow));
+        // The mip level for the group, from the rate at which the texture
+        // coordinates change at the group's start. Their horizontal rate is the
+        // group's step; their vertical rate is the derivative of (u/w) / (1/w).
+        unsigned mipLevel = 0;
+        if (texture)
+        {
+            const double dudy = ((planes.u.dy - (groupStartU * planes.invW.dy)) * groupStartW);
+            const double dvdy = ((planes.v.dy - (groupStartV * planes.invW.dy)) * groupStartW);
 
-        startRow = 0;
-    }
-    if (endRow >= int(dstPixelmap.height()))
-    {
-        endRow = (dstPixelmap.height() - 1);
-    }
+            mipLevel = texture->level_for(uStep, vStep, dudy, dvdy);
+        }
 
-    // Iterate over each y row in the triangle, on each row filling in a horizontal line between
-    // the left and right edge of the triangle.
-    for (int row = startRow; row <= endRow; row++)
-    {
-        paramsLeft.increment(deltasLeft);
-        paramsRight.increment(deltasRight);
-
-        fill_triangle_row(row,
-                          paramsLeft,
-                          paramsRight,
-                          triangleMaterial,
-                          dstPixelmap,
-                          dstDepthmap);
+        // Shade the pixels that passed.
+        for (int i = 0; i < groupLength; i++)
+        {
+            if (!isDrawn[i])
+            {
+                continue;
+            }
+
+            pixelRow[x + i] = texture
+                              ? texture->sample((groupStartU + (uStep * i)),
+                                                (groupStartV + (vStep * i)),
+                                                mipLevel)
+                              : triangleMaterial.baseColor;
+            numDrawn++;
+        }
+
+        groupStartW = groupEndW;
+        groupStartU = groupEndU;
+        groupStartV = groupEndV;
     }
 
-    return;
+    return numDrawn;
 }
 
-void vond::rasterize_triangle::scanline(const vond::triangle &tri,
-                                        vond::image<uint8_t, 4> &dstPixelmap,
-                                        vond::image<double, 1> &dstDepthmap)
+unsigned vond::rasterize_triangle::scanline(const vond::triangle &tri,
+                                            const vond::triangle_material &material,
+                                            vond::image<uint8_t, 4> &dstPixelmap,
+                                            vond::image<double, 1> &dstDepthmap,
+                                            const vond::rect<int> &clipRect)
 {
+    for (unsigned i = 0; i < 3; i++)
+    {
+        if ((std::abs(tri.v[i].position[0]) > MAX_COORDINATE) ||
+            (std::abs(tri.v[i].position[1]) > MAX_COORDINATE))
+        {
+            return 0;
+        }
+    }
+
     // Sort the triangle's vertices by height. ('High' here means low y, such that
     // y = 0 is the top of the screen.)
     const vond::vertex *high = &tri.v[0];
@@ -237,20 +249,97 @@ void vond::rasterize_triangle::scanline(const vond::triangle &tri,
         std::swap(low, mid);
     }
 
-    // Split the triangle into two parts, one pointing up and the other down.
-    // (Split algo from Bastian Molkenthin's www.sunshine2k.de/coding/java/TriangleRasterization/TriangleRasterization.html.)
-    vond::vertex splitBase;
-    const double splitRatio = ((mid->position[1] - high->position[1]) / (double)(low->position[1] - high->position[1]));
-    splitBase.position[0] = (high->position[0] + ((low->position[0] - high->position[0]) * splitRatio));
-    splitBase.position[1] = mid->position[1];
-    splitBase.position[2] = std::lerp(high->position[2], low->position[2], splitRatio);
-    splitBase.w = std::lerp(high->w, low->w, splitRatio);
-    splitBase.uv[0] = std::lerp(high->uv[0], low->uv[0], splitRatio);
-    splitBase.uv[1] = std::lerp(high->uv[1], low->uv[1], splitRatio);
-
-    // Fill in the up and down triangles, respectively.
-    fill_split_triangle(high, mid, &splitBase, tri.material, dstPixelmap, dstDepthmap);
-    fill_split_triangle(low, mid, &splitBase, tri.material, dstPixelmap, dstDepthmap);
-
-    return;
+    const vond::vertex *const verts[3] = {high, mid, low};
+
+    // Snap the vertices to the sub-pixel grid.
+    int64_t fx[3], fy[3];
+    for (unsigned i = 0; i < 3; i++)
+    {
+        fx[i] = std::llround(verts[i]->position[0] * SUBPIXEL_SCALE);
+        fy[i] = std::llround(verts[i]->position[1] * SUBPIXEL_SCALE);
+    }
+
+    // Twice the triangle's signed area. Positive if the middle vertex is to the
+    // right of the long edge from the high vertex to the low one.
+    const int64_t area = (((fx[1] - fx[0]) * (fy[2] - fy[0])) - ((fy[1] - fy[0]) * (fx[2] - fx[0])));
+
+    if (area == 0)
+    {
+        return 0;
+    }
+
+    interpolation_planes_s planes;
+    {
+        double x[3], y[3];
+        for (unsigned i = 0; i < 3; i++)
+        {
+            x[i] = (fx[i] / double(SUBPIXEL_SCALE));
+            y[i] = (fy[i] / double(SUBPIXEL_SCALE));
+        }
+
+        const auto make_plane = [&](const auto vertex_attribute)
+        {
+            return make_attribute_plane(x, y,
+                                        (vertex_attribute(verts[0]) / verts[0]->w),
+                                        (vertex_attribute(verts[1]) / verts[1]->w),
+                                        (vertex_attribute(verts[2]) / verts[2]->w));
+        };
+
+        planes.invW = make_plane([](const vond::vertex*){return 1.0;});
+        planes.u = make_plane([](const vond::vertex *v){return v->uv[0];});
+        planes.v = make_plane([](const vond::vertex *v){return v->uv[1];});
+        planes.depth = make_plane([](const vond::vertex *v){return v->position[2];});
+    }
+
+    // Fill rule: a pixel is drawn if its center is inside the triangle, or on its
+    // top or left edge; so that pixels shared by adjacent triangles are drawn only
+    // once. Hence the rows from the one at or below the high vertex up to but not
+    // including the one at or below the low vertex.
+    const int midRow = ceil_div(fy[1], SUBPIXEL_SCALE);
+    const int startRow = std::max(int(ceil_div(fy[0], SUBPIXEL_SCALE)), clipRect.top());
+    const int endRow = std::min(int(ceil_div(fy[2], SUBPIXEL_SCALE) - 1), clipRect.bottom());
+
+    if (startRow > endRow)
+    {
+        return 0;
+    }
+
+    // Walk down the long edge on one side and the two short edges on the other,
+    // filling in the span between them on each row.
+    edge_stepper_s longEdge(fx[0], fy[0], fx[2], fy[2], startRow);
+
+    unsigned numDrawn = 0;
+
+    for (unsigned half = 0; half < 2; half++)
+    {
+        const int halfStartRow = (half? std::max(midRow, startRow) : startRow);
+        const int halfEndRow = (half? endRow : std::min((midRow - 1), endRow));
+
+        if (halfStartRow > halfEndRow)
+        {
+            continue;
+        }
+
+        edge_stepper_s shortEdge = (half? edge_stepper_s(fx[1], fy[1], fx[2], fy[2], halfStartRow)
+                                        : edge_stepper_s(fx[0], fy[0], fx[1], fy[1], halfStartRow));
+
+        edge_stepper_s &leftEdge = ((area > 0)? longEdge : shortEdge);
+        edge_stepper_s &rightEdge = ((area > 0)? shortEdge : longEdge);
+
+        for (int row = halfStartRow; row <= halfEndRow; row++)
+        {
+            const int left = std::max(int(leftEdge.x), clipRect.left());
+            const int right = std::min(int(rightEdge.x - 1), clipRect.right());
+
+            if (left <= right)
+            {
+                numDrawn += fill_span(row, left, right, planes, material, dstPixelmap, dstDepthmap);
+            }
+
+            leftEdge.step();
+            rightEdge.step();
+        }
+    }
+
+    return numDrawn;
 }
@@ -11,14 +11,18 @@
 #include <stdint.h>
 #include "vond/image.h"
 #include "vond/triangle.h"
+#include "vond/rect.h"
 
 namespace vond::rasterize_triangle
 {
     // Rasterizes the given triangle into the given pixel map using scanline-based
-    // rendering.
-    void scanline(const vond::triangle &tri,
-                  vond::image<uint8_t, 4> &dstPixelmap,
-                  vond::image<double, 1> &dstDepthmap);
+    // rendering. Only pixels within the given clip rectangle (edges inclusive) are
+    // drawn. Returns the number of pixels drawn, i.e. that passed the depth test.
+    unsigned scanline(const vond::triangle &tri,
+                      const vond::triangle_material &material,
+                      vond::image<uint8_t, 4> &dstPixelmap,
+                      vond::image<double, 1> &dstDepthmap,
+                      const vond::rect<int> &clipRect);
 }
 
 #endif
@@ -44,7 +44,7 @@ namespace vond
             return triRect;
         }
 
-        rect<T> clipped_against(const rect<T> &other)
+        rect<T> clipped_against(const rect<T> &other) const
         {
             rect<T> newRect;
 
@@ -54,23 +54,40 @@ void vond::render_landscape(std::function<vond::color_grayscale<double>(const vo
                             std::function<vond::color_rgb<uint8_t>(const vond::vector3<double> &outDirection, const vond::vector3<double> &viewerPosition)> skySampler,
                             vond::image<uint8_t, 4> &dstPixelmap,
                             vond::image<double, 1> &dstDepthmap,
-                            const vond::camera &camera)
+                            const vond::camera &camera,
+                            const vond::landscape_impostor *const farField,
+                            const vond::fog *const fog)
 {
     vond_assert((dstPixelmap.width() == dstDepthmap.width()) &&
                 (dstPixelmap.height() == dstDepthmap.height()),
                 "The pixel map must have the same resolution as the depth map.");
 
+    // Pixels are written without bounds checking, in groups of PIXEL_WIDTH_MULTIPLIER.
+    vond_assert(!(dstPixelmap.width() % PIXEL_WIDTH_MULTIPLIER),
+                "The pixel map's width must be a multiple of the pixel width multiplier.");
+
     const double aspectRatio = (dstPixelmap.width() / double(dstPixelmap.height()));
     const double tanFov = tan((camera.fov / 2.0) * (M_PI / 180.0));
     const vond::matrix44 viewMatrix = (vond::rotation_matrix(0, camera.orientation[1], 0) *
                                        vond::rotation_matrix(camera.orientation[0], 0, 0));
 
+    // Rays that travel farther than this (squared) distance along the ground plane
+    // take their color from the far field impostor rather than marching on.
+    const double farFieldRadiusSq = ((farField && farField->is_ready())
+                                     ? (farField->radius() * farField->radius())
+                                     : std::numeric_limits<double>::max());
+
+    // Rays needn't be traced past the point where fog hides everything.
+    const unsigned maxRayDepth = ((fog? std::min(double(MAX_RAY_LENGTH), fog->visibility_distance())
+                                      : MAX_RAY_LENGTH) / RAY_STEP_SIZE);
+
     // Loop through each horizontal slice on the screen.
     #pragma omp parallel for
     for (unsigned x = 0; x < dstPixelmap.width(); x += PIXEL_WIDTH_MULTIPLIER)
     {
         unsigned stepsTaken = 0;    // How many steps we've traced along the current vertical pixel.
         unsigned rayDepth = 0;      // How many steps the ray has traced into the current horizontal slice.
+        bool prevPixelIsLandscape = false;  // Whether the previous pixel in the slice was drawn by this function.
 
         const double screenPlaneX = ((2.0 * ((x + 0.5) / dstPixelmap.width()) - 1.0) * tanFov * aspectRatio);
 
@@ -110,6 +127,14 @@ void vond::render_landscape(std::function<vond::color_grayscale<double>(const vo
 
                 // Follow the ray through the heightmap.
                 {
+                    // The depth of any geometry (e.g. triangles) already drawn into
+                    // this pixel. The ray needn't travel past it.
+                    double occluderDepth = std::numeric_limits<double>::max();
+                    for (unsigned i = 0; i < PIXEL_WIDTH_MULTIPLIER; i++)
+                    {
+                        occluderDepth = std::min(occluderDepth, dstDepthmap.pixel_at<vond::image_bounds_checking_mode_e::none>((x + i), (dstDepthmap.height() - y - 1))[0]);
+                    }
+
                     // Don't trace rays that are directed upward and above the maximum
                     // height of the terrain.
                     if ((ray.pos[1] > 255) && (ray.dir[1] >= 0))
@@ -121,8 +146,51 @@ void vond::render_landscape(std::function<vond::color_grayscale<double>(const vo
                     // first voxel whose height is greater than the ray's height at that
                     // grid element. Once the ray intersects such a voxel, it'll be drawn
                     // to screen, and tracing for this screen slice ends.
-                    for (; rayDepth < (MAX_RAY_LENGTH / RAY_STEP_SIZE); stepsTaken++)
+                    for (; rayDepth < maxRayDepth; stepsTaken++)
                     {
+                        // Stop the ray if it's passed behind geometry that's already
+                        // been drawn into the pixel.
+                        if ((rayDepth * RAY_STEP_SIZE) >= occluderDepth)
+                        {
+                            // The ray didn't hit the terrain, so the next ray can
+                            // continue from here rather than from the camera.
+                            stepsTaken = std::max(stepsTaken, 1u);
+                            prevPixelIsLandscape = false;
+
+                            break;
+                        }
+
+                        // Composite the ray from the far field impostor if it's
+                        // reached the impostor's radius.
+                        if ((((ray.pos[0] - camera.position[0]) * (ray.pos[0] - camera.position[0])) +
+                             ((ray.pos[2] - camera.position[2]) * (ray.pos[2] - camera.position[2]))) >= farFieldRadiusSq)
+                        {
+                            const auto [farColor, farDepth] = farField->sample(ray.pos, camera.position);
+
+                            if (!farColor[3])
+                            {
+                                goto draw_sky;
+                            }
+
+                            // The ray didn't hit the terrain, so the next ray can
+                            // continue from here rather than from the camera.
+                            stepsTaken = std::max(stepsTaken, 1u);
+                            prevPixelIsLandscape = (farDepth < occluderDepth);
+
+                            if (!prevPixelIsLandscape)
+                            {
+                                break;
+                            }
+
+                            for (unsigned i = 0; i < PIXEL_WIDTH_MULTIPLIER; i++)
+                            {
+                                dstPixelmap.pixel_at<vond::image_bounds_checking_mode_e::none>((x + i), (dstPixelmap.height() - y - 1)) = farColor;
+                                dstDepthmap.pixel_at<vond::image_bounds_checking_mode_e::none>((x + i), (dstDepthmap.height() - y - 1)) = {farDepth};
+                            }
+
+                            break;
+                        }
+
                         // Get the height of the voxel that's directly below this ray.
                         double voxelHeight = heightmapSampler(ray.pos, camera.position).channel_at(0);
 
@@ -140,10 +208,12 @@ void vond::render_landscape(std::function<vond::color_grayscale<double>(const vo
 
                             const double depth = ray.pos.distance_to(camera.position);
 
+                            prevPixelIsLandscape = true;
+
                             for (unsigned i = 0; i < PIXEL_WIDTH_MULTIPLIER; i++)
                             {
-                                dstPixelmap.pixel_at((x + i), (dstPixelmap.height() - y - 1)) = groundColor;
-                                dstDepthmap.pixel_at((x + i), (dstDepthmap.height() - y - 1)) = {depth};
+                                dstPixelmap.pixel_at<vond::image_bounds_checking_mode_e::none>((x + i), (dstPixelmap.height() - y - 1)) = groundColor;
+                                dstDepthmap.pixel_at<vond::image_bounds_checking_mode_e::none>((x + i), (dstDepthmap.height() - y - 1)) = {depth};
                             }
 
                             break;
@@ -160,6 +230,24 @@ void vond::render_landscape(std::function<vond::color_grayscale<double>(const vo
                             goto draw_sky;
                         }
                     }
+
+                    // If the ray reached the limit of visibility in the fog without
+                    // hitting anything, draw the fog's color.
+                    if (fog &&
+                        (rayDepth >= maxRayDepth) &&
+                        (fog->visibility_distance() < occluderDepth))
+                    {
+                        const vond::color_rgb<uint8_t> fogColor = fog->color();
+
+                        for (unsigned i = 0; i < PIXEL_WIDTH_MULTIPLIER; i++)
+                        {
+                            dstPixelmap.pixel_at<vond::image_bounds_checking_mode_e::none>((x + i), (dstPixelmap.height() - y - 1)) = {fogColor[0], fogColor[1], fogColor[2], 255};
+                            dstDepthmap.pixel_at<vond::image_bounds_checking_mode_e::none>((x + i), (dstDepthmap.height() - y - 1)) = {fog->visibility_distance()};
+                        }
+
+                        stepsTaken = std::max(stepsTaken, 1u);
+                        prevPixelIsLandscape = true;
+                    }
                 }
             }
 
@@ -167,21 +255,31 @@ void vond::render_landscape(std::function<vond::color_grayscale<double>(const vo
             draw_sky:
             {
                 // Kludge fix for there sometimes being 1 pixel thick holes between the terrain and the sky.
-                if ((y > 0) && (y < (dstPixelmap.height() - 1)))
+                bool isKludgePixel = false;
+                if ((y > 0) && (y < (dstPixelmap.height() - 1)) && prevPixelIsLandscape)
                 {
                     y--;
+                    isKludgePixel = true;
                 }
 
-                for (; y < dstPixelmap.height(); y++)
+                for (; y < dstPixelmap.height(); y++, isKludgePixel = false)
                 {
+                    // Leave alone pixels that other geometry (e.g. triangles) has
+                    // already been drawn into.
+                    if (!isKludgePixel &&
+                        (dstDepthmap.pixel_at<vond::image_bounds_checking_mode_e::none>(x, (dstDepthmap.height() - y - 1))[0] < std::numeric_limits<double>::max()))
+                    {
+                        continue;
+                    }
+
                     const double screenPlaneY = (2.0 * ((y + 0.5) / dstPixelmap.height()) - 1.0) * tanFov;
                     const auto rayDirection = (vond::vector3<double>{screenPlaneX, screenPlaneY, camera.zoom} * viewMatrix).normalized();
                     const vond::color_rgb<uint8_t> skyColor = skySampler(rayDirection, camera.position);
 
                     for (unsigned i = 0; i < PIXEL_WIDTH_MULTIPLIER; i++)
                     {
-                        dstPixelmap.pixel_at((x + i), (dstPixelmap.height() - y - 1)) = {skyColor[0], skyColor[1], skyColor[2], 255};
-                        dstDepthmap.pixel_at((x + i), (dstDepthmap.height() - y - 1)) = {std::numeric_limits<double>::max()};
+                        dstPixelmap.pixel_at<vond::image_bounds_checking_mode_e::none>((x + i), (dstPixelmap.height() - y - 1)) = {skyColor[0], skyColor[1], skyColor[2], 255};
+                        dstDepthmap.pixel_at<vond::image_bounds_checking_mode_e::none>((x + i), (dstDepthmap.height() - y - 1)) = {std::numeric_limits<double>::max()};
                     }
                 }
             }
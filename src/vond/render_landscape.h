@@ -12,6 +12,8 @@
 #include "vond/color.h"
 #include "vond/image_mosaic.h"
 #include "vond/camera.h"
+#include "vond/landscape_impostor.h"
+#include "vond/fog.h"
 
 namespace vond
 {
@@ -20,7 +22,9 @@ namespace vond
                           std::function<vond::color_rgb<uint8_t>(const vond::vector3<double> &outDirection, const vond::vector3<double> &viewerPosition)> skySampler,
                           vond::image<uint8_t, 4> &dstPixelmap,
                           vond::image<double, 1> &dstDepthmap,
-                          const vond::camera &camera);
+                          const vond::camera &camera,
+                          const vond::landscape_impostor *const farField = nullptr,
+                          const vond::fog *const fog = nullptr);
 }
 
 #endif
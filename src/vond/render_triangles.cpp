@@ -7,12 +7,18 @@
  */
 
 #include <cmath>
+#include <algorithm>
+#include <unordered_map>
 #include "vond/matrix.h"
 #include "vond/camera.h"
 #include "vond/image.h"
-#include "vond/rasterize_triangle_barycentric.h"
+#include "vond/rect.h"
 #include "vond/rasterize_triangle_scanline.h"
+#include "vond/rasterize_triangle_barycentric.h"
+#include "vond/rasterize_triangle_half_space.h"
+#include "vond/rasterize_triangle_point.h"
 #include "vond/render_triangles.h"
+#include "vond/frustum.h"
 
 #define DEG_TO_RAD(deg) ((deg) * (M_PI / 180.0))
 
@@ -20,109 +26,744 @@
 static const double Z_NEAR = 0.1;
 static const double Z_FAR = 1;
 
-static std::vector<vond::triangle> transform_triangles(const std::vector<vond::triangle> &triangles,
-                                                       const unsigned screenWidth,
-                                                       const unsigned screenHeight,
-                                                       const vond::camera &camera)
+// Mesh instances are drawn with their least detailed level of detail whose
+// deviation from the full mesh is at most this many pixels on screen.
+static const double LOD_MAX_SCREEN_ERROR = 1;
+
+// How far, in pixels, triangles may extend past the edges of the screen before
+// they're clipped. The rasterizers clip triangles to the screen per pixel row or
+// block, so only triangles large enough to risk overflowing the rasterizers'
+// fixed-point coordinates need to be clipped geometrically.
+static const double GUARD_BAND = (1 << 14);
+
+// The width and height, in pixels, of the screen tiles into which triangles are
+// binned for rasterization. Each tile is rasterized by a single thread.
+static const unsigned TILE_SIZE = 64;
+
+// Triangles whose screen-space area, in pixels, is below this are drawn with the
+// half-space rasterizer, and larger ones with the scanline rasterizer. Measured:
+// the half-space rasterizer's setup is cheaper, but the scanline rasterizer fills
+// long spans faster.
+static const double HALF_SPACE_MAX_AREA = 32;
+
+// When sorting triangles front to back, their depths are grouped into buckets
+// this many per doubling of distance, so that triangles at similar depths are
+// ordered by material instead.
+static const double DEPTH_BUCKETS_PER_OCTAVE = 16;
+
+// The rasterizers among which triangles are distributed.
+enum class rasterizer_e : uint8_t
+{
+    point,
+    barycentric,
+    half_space,
+    scanline
+};
+
+// Returns the rasterizer that's cheapest for drawing the given screen-space triangle.
+static rasterizer_e cheapest_rasterizer(const vond::triangle &tri)
+{
+    // Sub-pixel size, i.e. spanning less than a pixel on both axes, in which case
+    // the triangle covers at most one pixel center.
+    if (((std::max({tri.v[0].position[0], tri.v[1].position[0], tri.v[2].position[0]}) -
+          std::min({tri.v[0].position[0], tri.v[1].position[0], tri.v[2].position[0]})) < 1) &&
+        ((std::max({tri.v[0].position[1], tri.v[1].position[1], tri.v[2].position[1]}) -
+          std::min({tri.v[0].position[1], tri.v[1].position[1], tri.v[2].position[1]})) < 1))
+    {
+        return rasterizer_e::point;
+    }
+
+    const double area = (std::abs(((tri.v[1].position[0] - tri.v[0].position[0]) * (tri.v[2].position[1] - tri.v[0].position[1])) -
+                                  ((tri.v[1].position[1] - tri.v[0].position[1]) * (tri.v[2].position[0] - tri.v[0].position[0]))) / 2);
+
+    return ((area < HALF_SPACE_MAX_AREA)? rasterizer_e::half_space : rasterizer_e::scanline);
+}
+
+// Buffers reused from frame to frame, so that rendering needn't allocate memory
+// once they've grown to fit the scene.
+static struct
+{
+    // The transformed vertices of the mesh currently being transformed, in the
+    // same order as in its vertex buffer.
+    std::vector<double> screenX;
+    std::vector<double> screenY;
+    std::vector<double> w;
+    std::vector<double> depth;
+
+    // The transformed triangles of all visible instances, and each triangle's
+    // material. Only the first numTriangles are current; the rest are kept around
+    // to reuse their memory.
+    std::vector<vond::triangle> triangles;
+    std::vector<const vond::triangle_material*> materials;
+    unsigned numTriangles = 0;
+
+    std::vector<rasterizer_e> rasterizers;
+    std::vector<std::vector<unsigned>> tileBins;
+
+    // For sorting the triangles: their sort keys and the resulting draw order,
+    // scratch space for the sort, and a compact key for each texture in use.
+    std::vector<uint32_t> sortKeys;
+    std::vector<uint32_t> drawOrder;
+    std::vector<uint32_t> sortKeysScratch;
+    std::vector<uint32_t> drawOrderScratch;
+    std::unordered_map<const vond::texture*, uint16_t> textureKeys;
+
+    // For the stats, each screen tile's depths before the triangles are drawn,
+    // TILE_SIZE * TILE_SIZE per tile.
+    std::vector<double> initialTileDepths;
+} BUFFERS;
+
+// Transforms the vertices of the given mesh by the given matrices, into
+// BUFFERS.screenX/screenY/w/depth.
+static void transform_vertices(const vond::mesh &mesh,
+                               const vond::matrix44 &toViewSpace,
+                               const vond::matrix44 &toScreenSpace)
+{
+    const unsigned numVertices = mesh.num_vertices();
+
+    BUFFERS.screenX.resize(numVertices);
+    BUFFERS.screenY.resize(numVertices);
+    BUFFERS.w.resize(numVertices);
+    BUFFERS.depth.resize(numVertices);
+
+    const double *const m = toScreenSpace.elements;
+    const double *const mv = toViewSpace.elements;
+    const double *const srcX = mesh.x.data();
+    const double *const srcY = mesh.y.data();
+    const double *const srcZ = mesh.z.data();
+    double *const dstX = BUFFERS.screenX.data();
+    double *const dstY = BUFFERS.screenY.data();
+    double *const dstW = BUFFERS.w.data();
+    double *const dstDepth = BUFFERS.depth.data();
+
+    #pragma omp simd
+    for (unsigned i = 0; i < numVertices; i++)
+    {
+        const double viewX = ((mv[0] * srcX[i]) + (mv[4] * srcY[i]) + (mv[ 8] * srcZ[i]) + mv[12]);
+        const double viewY = ((mv[1] * srcX[i]) + (mv[5] * srcY[i]) + (mv[ 9] * srcZ[i]) + mv[13]);
+        const double viewZ = ((mv[2] * srcX[i]) + (mv[6] * srcY[i]) + (mv[10] * srcZ[i]) + mv[14]);
+
+        dstX[i] = ((m[0] * srcX[i]) + (m[4] * srcY[i]) + (m[ 8] * srcZ[i]) + m[12]);
+        dstY[i] = ((m[1] * srcX[i]) + (m[5] * srcY[i]) + (m[ 9] * srcZ[i]) + m[13]);
+        dstW[i] = ((m[3] * srcX[i]) + (m[7] * srcY[i]) + (m[11] * srcZ[i]) + m[15]);
+        dstDepth[i] = sqrt((viewX * viewX) + (viewY * viewY) + (viewZ * viewZ));
+    }
+
+    return;
+}
+
+// A triangle vertex in homogeneous screen space, i.e. before perspective division.
+struct clip_vertex_s
+{
+    double x;
+    double y;
+    double w;
+    double depth;
+    double u;
+    double v;
+
+    clip_vertex_s lerp(const clip_vertex_s &other, const double t) const
+    {
+        return {(this->x + ((other.x - this->x) * t)),
+                (this->y + ((other.y - this->y) * t)),
+                (this->w + ((other.w - this->w) * t)),
+                (this->depth + ((other.depth - this->depth) * t)),
+                (this->u + ((other.u - this->u) * t)),
+                (this->v + ((other.v - this->v) * t))};
+    }
+};
+
+// A clipping plane in homogeneous screen space. Vertices for which
+// (a * x) + (b * y) + (c * w) + d is non-negative are on the inner side.
+struct clip_plane_s
 {
-    // Create a matrix by which we can transform the triangles into screen-space.
-    vond::matrix44 toWorldSpace;
+    double a;
+    double b;
+    double c;
+    double d;
+
+    double distance(const clip_vertex_s &vertex) const
     {
-        const vond::vector3<double> objectPos = {512, 110, 512};
-        toWorldSpace = vond::translation_matrix(objectPos[0], objectPos[1], objectPos[2]);
+        return ((this->a * vertex.x) + (this->b * vertex.y) + (this->c * vertex.w) + this->d);
     }
+};
+
+// Clips the given convex polygon against the given plane (Sutherland-Hodgman),
+// storing the result into the given destination array, which must have room for
+// one vertex more than the source polygon. Returns the number of vertices in the
+// clipped polygon.
+static unsigned clip_polygon(const clip_vertex_s *const src,
+                             const unsigned numSrc,
+                             const clip_plane_s &plane,
+                             clip_vertex_s *const dst)
+{
+    unsigned numDst = 0;
 
-    vond::matrix44 toClipSpace;
+    for (unsigned i = 0; i < numSrc; i++)
     {
-        const vond::matrix44 cameraMatrix = vond::rotation_matrix(-camera.orientation[0], -camera.orientation[1], camera.orientation[2]) *
-                                            vond::translation_matrix(-camera.position[0], -camera.position[1], -camera.position[2]);
+        const clip_vertex_s &cur = src[i];
+        const clip_vertex_s &next = src[(i + 1) % numSrc];
+        const double curDistance = plane.distance(cur);
+        const double nextDistance = plane.distance(next);
 
-        const vond::matrix44 perspectiveMatrix = vond::perspective_matrix(DEG_TO_RAD(camera.fov),
-                                                                          (double(screenWidth) / screenHeight),
-                                                                          Z_NEAR, Z_FAR);
+        if (curDistance >= 0)
+        {
+            dst[numDst++] = cur;
+        }
 
-        toClipSpace = (perspectiveMatrix * cameraMatrix);
+        if ((curDistance >= 0) != (nextDistance >= 0))
+        {
+            dst[numDst++] = cur.lerp(next, (curDistance / (curDistance - nextDistance)));
+        }
     }
 
-    const vond::matrix44 toScreenSpace = vond::screen_space_matrix((screenWidth / 2.0),
-                                                                   (screenHeight / 2.0));
+    return numDst;
+}
+
+// Projects the given triangle onto the screen and appends it to BUFFERS.triangles
+// with the given material, unless it's facing away from the camera or is entirely
+// outside the screen. Expects the triangle to be in front of the camera.
+static void emit_triangle(const clip_vertex_s &v0,
+                          const clip_vertex_s &v1,
+                          const clip_vertex_s &v2,
+                          const vond::triangle_material *const material,
+                          const unsigned screenWidth,
+                          const unsigned screenHeight)
+{
+    const clip_vertex_s *const verts[3] = {&v0, &v1, &v2};
+
+    // Perspective division.
+    double x[3], y[3];
+    for (unsigned i = 0; i < 3; i++)
+    {
+        x[i] = (verts[i]->x / verts[i]->w);
+        y[i] = (verts[i]->y / verts[i]->w);
+    }
 
+    // Cull triangles facing away from the camera, i.e. those whose vertices wind
+    // counter-clockwise on the screen (given that y grows downward).
+    if ((((x[1] - x[0]) * (y[2] - y[0])) - ((y[1] - y[0]) * (x[2] - x[0]))) >= 0)
+    {
+        return;
+    }
 
-    // Transform the triangles.
-    std::vector<vond::triangle> transformedTris;
+    // Cull triangles that are entirely outside the screen.
     {
-        double vertDepths[3];
+        if ((x[0] < 0 && x[1] < 0 && x[2] < 0) ||
+            (y[0] < 0 && y[1] < 0 && y[2] < 0))
+        {
+            return;
+        }
 
-        for (auto tri: triangles)
+        if ((x[0] >= (int)screenWidth && x[1] >= (int)screenWidth && x[2] >= (int)screenWidth) ||
+            (y[0] >= (int)screenHeight && y[1] >= (int)screenHeight && y[2] >= (int)screenHeight))
         {
-            tri.v[0].transform(toWorldSpace);
-            tri.v[1].transform(toWorldSpace);
-            tri.v[2].transform(toWorldSpace);
+            return;
+        }
+    }
+
+    if (BUFFERS.numTriangles == BUFFERS.triangles.size())
+    {
+        BUFFERS.triangles.emplace_back();
+        BUFFERS.materials.emplace_back();
+    }
+
+    vond::triangle &tri = BUFFERS.triangles[BUFFERS.numTriangles];
+
+    for (unsigned i = 0; i < 3; i++)
+    {
+        tri.v[i].position = {x[i], y[i], verts[i]->depth};
+        tri.v[i].uv = {verts[i]->u, verts[i]->v};
+        tri.v[i].w = verts[i]->w;
+    }
 
-            vertDepths[0] = tri.v[0].position.distance_to(camera.position);
-            vertDepths[1] = tri.v[1].position.distance_to(camera.position);
-            vertDepths[2] = tri.v[2].position.distance_to(camera.position);
+    BUFFERS.materials[BUFFERS.numTriangles] = material;
 
-            tri.v[0].transform(toClipSpace);
-            tri.v[1].transform(toClipSpace);
-            tri.v[2].transform(toClipSpace);
+    BUFFERS.numTriangles++;
 
-            /// Temp hack. Prevent triangles behind the camera from wigging out.
-            if (tri.v[0].w <= 0 ||
-                tri.v[1].w <= 0 ||
-                tri.v[2].w <= 0)
+    return;
+}
+
+// Appends to BUFFERS.triangles those of the given mesh's triangles that face the
+// camera and are on screen, assembled from the mesh's transformed vertices.
+//
+// Triangles that cross the near plane, or that extend past the guard band around
+// the screen, are clipped in homogeneous space. The rest - nearly all triangles -
+// are passed through unclipped, the rasterizers clipping them to the screen as
+// they draw.
+static void assemble_triangles(const vond::mesh &mesh,
+                               const unsigned screenWidth,
+                               const unsigned screenHeight)
+{
+    const clip_plane_s clipPlanes[] = {
+        {0, 0, 1, -Z_NEAR},
+        {1, 0, GUARD_BAND, 0},
+        {-1, 0, (screenWidth + GUARD_BAND), 0},
+        {0, 1, GUARD_BAND, 0},
+        {0, -1, (screenHeight + GUARD_BAND), 0},
+    };
+
+    for (unsigned t = 0; t < mesh.num_triangles(); t++)
+    {
+        const uint32_t *const vertIdx = &mesh.indices[t * 3];
+        const vond::triangle_material *const material = &mesh.materials[mesh.materialIndices[t]];
+
+        clip_vertex_s verts[3];
+        for (unsigned i = 0; i < 3; i++)
+        {
+            verts[i] = {BUFFERS.screenX[vertIdx[i]],
+                        BUFFERS.screenY[vertIdx[i]],
+                        BUFFERS.w[vertIdx[i]],
+                        BUFFERS.depth[vertIdx[i]],
+                        mesh.u[vertIdx[i]],
+                        mesh.v[vertIdx[i]]};
+        }
+
+        bool isClipped = false;
+        for (const clip_plane_s &plane: clipPlanes)
+        {
+            const double d0 = plane.distance(verts[0]);
+            const double d1 = plane.distance(verts[1]);
+            const double d2 = plane.distance(verts[2]);
+
+            // Entirely outside one of the planes.
+            if ((d0 < 0) && (d1 < 0) && (d2 < 0))
             {
-                continue;
+                goto next_triangle;
             }
 
-            tri.v[0].transform(toScreenSpace);
-            tri.v[1].transform(toScreenSpace);
-            tri.v[2].transform(toScreenSpace);
+            isClipped |= ((d0 < 0) || (d1 < 0) || (d2 < 0));
+        }
+
+        if (!isClipped)
+        {
+            emit_triangle(verts[0], verts[1], verts[2], material, screenWidth, screenHeight);
+        }
+        else
+        {
+            // Each plane can add at most one vertex to the polygon.
+            clip_vertex_s polygon[2][3 + std::size(clipPlanes)];
+            unsigned numVerts = 3;
+
+            std::copy(verts, (verts + 3), polygon[0]);
 
-            // Perspective division.
-            for (unsigned i = 0; i < 3; i++)
+            for (unsigned p = 0; p < std::size(clipPlanes); p++)
             {
-                tri.v[i].position[0] /= tri.v[i].w;
-                tri.v[i].position[1] /= tri.v[i].w;
+                numVerts = clip_polygon(polygon[p % 2], numVerts, clipPlanes[p], polygon[(p + 1) % 2]);
             }
 
-            // Cull triangles that are entirely outside the screen.
+            const clip_vertex_s *const clipped = polygon[std::size(clipPlanes) % 2];
+
+            for (unsigned i = 1; (i + 1) < numVerts; i++)
             {
-                if ((tri.v[0].position[0] < 0 && tri.v[1].position[0] < 0 && tri.v[2].position[0] < 0) ||
-                    (tri.v[0].position[1] < 0 && tri.v[1].position[1] < 0 && tri.v[2].position[1] < 0))
+                emit_triangle(clipped[0], clipped[i], clipped[i + 1], material, screenWidth, screenHeight);
+            }
+        }
+
+        next_triangle:;
+    }
+
+    return;
+}
+
+// Returns the matrix that transforms world space into the given camera's view space.
+static vond::matrix44 world_to_view_matrix(const vond::camera &camera)
+{
+    return (vond::rotation_matrix(-camera.orientation[0], -camera.orientation[1], camera.orientation[2]) *
+            vond::translation_matrix(-camera.position[0], -camera.position[1], -camera.position[2]));
+}
+
+// Returns the matrix that transforms the given camera's view space into clip space.
+static vond::matrix44 view_to_clip_matrix(const vond::camera &camera,
+                                          const unsigned screenWidth,
+                                          const unsigned screenHeight)
+{
+    return vond::perspective_matrix(DEG_TO_RAD(camera.fov),
+                                    (double(screenWidth) / screenHeight),
+                                    Z_NEAR, Z_FAR);
+}
+
+// Returns the level of detail at which to draw the given mesh instance, i.e. the
+// least detailed of its mesh's LODs that differs from the full mesh by at most
+// LOD_MAX_SCREEN_ERROR pixels at the instance's distance from the camera. The
+// scale factor gives the number of pixels spanned by one world unit at a
+// distance of one unit.
+static const vond::mesh& level_of_detail(const vond::mesh_instance &instance,
+                                         const vond::camera &camera,
+                                         const double pixelsPerUnit)
+{
+    const vond::mesh &mesh = *instance.mesh;
+
+    if (mesh.lods.empty())
+    {
+        return mesh;
+    }
+
+    // The distance to the nearest point of the instance's bounding sphere.
+    const double radius = instance.bounding_radius();
+    const double distance = (instance.bounding_center().distance_to(camera.position) - radius);
+
+    if (distance <= 0)
+    {
+        return mesh;
+    }
+
+    // Object space to screen pixels, at the instance's distance.
+    const double objectToPixels = ((radius / mesh.boundingRadius) * (pixelsPerUnit / distance));
+
+    const vond::mesh *lod = &mesh;
+
+    for (const vond::mesh &candidate: mesh.lods)
+    {
+        if ((candidate.lodError * objectToPixels) > LOD_MAX_SCREEN_ERROR)
+        {
+            break;
+        }
+
+        lod = &candidate;
+    }
+
+    return *lod;
+}
+
+// Transforms the triangles of the given mesh instances into screen space, storing
+// those that are in front of the camera and on screen into BUFFERS.triangles.
+// Instances whose bounding sphere is outside the camera's view are skipped
+// without transforming their vertices, and the rest are drawn at a level of
+// detail fitting their size on screen. Returns the number of instances skipped.
+static unsigned transform_triangles(const std::vector<const vond::mesh_instance*> &instances,
+                                    const unsigned screenWidth,
+                                    const unsigned screenHeight,
+                                    const vond::camera &camera)
+{
+    const vond::matrix44 cameraMatrix = world_to_view_matrix(camera);
+
+    const vond::matrix44 perspectiveMatrix = view_to_clip_matrix(camera, screenWidth, screenHeight);
+
+    const vond::matrix44 toScreenFromViewSpace = (vond::screen_space_matrix((screenWidth / 2.0), (screenHeight / 2.0)) *
+                                                  perspectiveMatrix);
+
+    const vond::frustum viewFrustum(perspectiveMatrix * cameraMatrix);
+
+    const double pixelsPerUnit = ((screenHeight / 2.0) / tan(DEG_TO_RAD(camera.fov) / 2));
+
+    unsigned numCulled = 0;
+
+    BUFFERS.numTriangles = 0;
+
+    for (const vond::mesh_instance *const instance: instances)
+    {
+        if (!viewFrustum.intersects_sphere(instance->bounding_center(), instance->bounding_radius()))
+        {
+            numCulled++;
+            continue;
+        }
+
+        // The camera matrix is rigid, so a vertex's distance from the camera is
+        // its distance from the origin in view space.
+        const vond::matrix44 toViewSpace = (cameraMatrix * instance->transform);
+        const vond::matrix44 toScreenSpace = (toScreenFromViewSpace * toViewSpace);
+        const vond::mesh &mesh = level_of_detail(*instance, camera, pixelsPerUnit);
+
+        transform_vertices(mesh, toViewSpace, toScreenSpace);
+        assemble_triangles(mesh, screenWidth, screenHeight);
+    }
+
+    return numCulled;
+}
+
+vond::frustum vond::camera_frustum(const vond::camera &camera,
+                                   const unsigned screenWidth,
+                                   const unsigned screenHeight)
+{
+    return vond::frustum(view_to_clip_matrix(camera, screenWidth, screenHeight) * world_to_view_matrix(camera));
+}
+
+// Sorts the given keys, and the values alongside them, in ascending order of
+// key by LSD radix sort. The sort is stable. Digits in which all the keys agree
+// are skipped.
+static void radix_sort(std::vector<uint32_t> &keys,
+                       std::vector<uint32_t> &values,
+                       std::vector<uint32_t> &keysScratch,
+                       std::vector<uint32_t> &valuesScratch,
+                       const unsigned count)
+{
+    keysScratch.resize(count);
+    valuesScratch.resize(count);
+
+    for (unsigned shift = 0; shift < 32; shift += 8)
+    {
+        unsigned offsets[256] = {0};
+
+        for (unsigned i = 0; i < count; i++)
+        {
+            offsets[(keys[i] >> shift) & 0xff]++;
+        }
+
+        if (offsets[(keys[0] >> shift) & 0xff] == count)
+        {
+            continue;
+        }
+
+        for (unsigned digit = 0, total = 0; digit < 256; digit++)
+        {
+            const unsigned digitCount = offsets[digit];
+            offsets[digit] = total;
+            total += digitCount;
+        }
+
+        for (unsigned i = 0; i < count; i++)
+        {
+            const unsigned dst = offsets[(keys[i] >> shift) & 0xff]++;
+            keysScratch[dst] = keys[i];
+            valuesScratch[dst] = values[i];
+        }
+
+        keys.swap(keysScratch);
+        values.swap(valuesScratch);
+    }
+
+    return;
+}
+
+// Fills BUFFERS.drawOrder with the indices of the first numTriangles triangles in
+// BUFFERS.triangles, ordered coarsely front to back - by depth bucket - and within
+// each depth bucket by texture. Drawing near triangles first lets the depth test
+// reject more of the pixels behind them before they're shaded, and drawing
+// triangles of the same texture together keeps the texture in the cache.
+static void sort_triangles(const unsigned numTriangles)
+{
+    std::vector<uint32_t> &keys = BUFFERS.sortKeys;
+    std::vector<uint32_t> &order = BUFFERS.drawOrder;
+
+    keys.resize(numTriangles);
+    order.resize(numTriangles);
+
+    BUFFERS.textureKeys.clear();
+
+    const vond::texture *prevTexture = nullptr;
+    uint16_t textureKey = 0;
+
+    for (unsigned i = 0; i < numTriangles; i++)
+    {
+        const vond::triangle &tri = BUFFERS.triangles[i];
+        const vond::texture *const texture = BUFFERS.materials[i]->texture;
+
+        // Consecutive triangles tend to share a texture, so the lookup can mostly
+        // be skipped.
+        if ((i == 0) || (texture != prevTexture))
+        {
+            textureKey = BUFFERS.textureKeys.insert({texture, uint16_t(BUFFERS.textureKeys.size())}).first->second;
+            prevTexture = texture;
+        }
+
+        const double nearestDepth = std::min({tri.v[0].position[2], tri.v[1].position[2], tri.v[2].position[2]});
+        const uint32_t depthBucket = std::min(65535.0, (std::log2(1 + std::max(0.0, nearestDepth)) * DEPTH_BUCKETS_PER_OCTAVE));
+
+        keys[i] = ((depthBucket << 16) | textureKey);
+        order[i] = i;
+    }
+
+    if (numTriangles)
+    {
+        radix_sort(keys, order, BUFFERS.sortKeysScratch, BUFFERS.drawOrderScratch, numTriangles);
+    }
+
+    return;
+}
+
+void vond::render_triangles(const std::vector<const vond::mesh_instance*> &instances,
+                            vond::image<uint8_t, 4> &dstPixelmap,
+                            vond::image<double, 1> &dstDepthmap,
+                            const vond::camera &camera,
+                            const vond::depth_pyramid *const occluders,
+                            vond::triangle_raster_stats *const stats,
+                            const bool isSortedFrontToBack,
+                            const vond::triangle_rasterizer_e rasterizer)
+{
+    vond::triangle_raster_stats counts;
+
+    counts.numCulledInstances = transform_triangles(instances, dstPixelmap.width(), dstPixelmap.height(), camera);
+
+    const std::vector<vond::triangle> &transformedTriangles = BUFFERS.triangles;
+    const unsigned numTriangles = BUFFERS.numTriangles;
+
+    if (isSortedFrontToBack)
+    {
+        sort_triangles(numTriangles);
+    }
+
+    std::vector<rasterizer_e> &rasterizers = BUFFERS.rasterizers;
+    {
+        rasterizers.resize(numTriangles);
+
+        switch (rasterizer)
+        {
+            case vond::triangle_rasterizer_e::barycentric: std::fill_n(rasterizers.begin(), numTriangles, rasterizer_e::barycentric); break;
+            case vond::triangle_rasterizer_e::half_space: std::fill_n(rasterizers.begin(), numTriangles, rasterizer_e::half_space); break;
+            case vond::triangle_rasterizer_e::scanline: std::fill_n(rasterizers.begin(), numTriangles, rasterizer_e::scanline); break;
+            case vond::triangle_rasterizer_e::automatic:
+            {
+                for (unsigned i = 0; i < numTriangles; i++)
                 {
-                    continue;
+                    rasterizers[i] = cheapest_rasterizer(transformedTriangles[i]);
                 }
 
-                if ((tri.v[0].position[0] >= (int)screenWidth && tri.v[1].position[0] >= (int)screenWidth && tri.v[2].position[0] >= (int)screenWidth) ||
-                    (tri.v[0].position[1] >= (int)screenHeight && tri.v[1].position[1] >= (int)screenHeight && tri.v[2].position[1] >= (int)screenHeight))
+                break;
+            }
+        }
+    }
+
+    const unsigned numTilesX = ((dstPixelmap.width() + TILE_SIZE - 1) / TILE_SIZE);
+    const unsigned numTilesY = ((dstPixelmap.height() + TILE_SIZE - 1) / TILE_SIZE);
+
+    // Bin the triangles into the screen tiles they overlap. The bins preserve the
+    // triangles' draw order, so the draw order is the same regardless of threading.
+    // A triangle isn't binned into tiles where it's hidden behind the occluders.
+    std::vector<std::vector<unsigned>> &tileBins = BUFFERS.tileBins;
+    {
+        tileBins.resize(numTilesX * numTilesY);
+
+        for (std::vector<unsigned> &bin: tileBins)
+        {
+            bin.clear();
+        }
+
+        const vond::rect<int> screenRect = {{0, 0}, {int(dstPixelmap.width() - 1), int(dstPixelmap.height() - 1)}};
+
+        for (unsigned k = 0; k < numTriangles; k++)
+        {
+            const unsigned i = (isSortedFrontToBack? BUFFERS.drawOrder[k] : k);
+            const vond::triangle &tri = transformedTriangles[i];
+
+            // A triangle drawn as a point is binned by the pixel it'll be drawn at,
+            // which may be outside its bounding rect.
+            vond::rect<int> triRect;
+            if (rasterizers[i] == rasterizer_e::point)
+            {
+                const vond::vector2<int> pixel = vond::rasterize_triangle::point_pixel(tri);
+                triRect = vond::rect<int>{pixel, pixel}.clipped_against(screenRect);
+            }
+            else
+            {
+                triRect = vond::rect<int>::from_triangle(tri).clipped_against(screenRect);
+            }
+
+            if ((triRect.width() < 0) || (triRect.height() < 0))
+            {
+                continue;
+            }
+
+            // The rasterizers interpolate depth between the vertices, so none of
+            // the triangle's pixels will be nearer than its nearest vertex.
+            const double nearestDepth = std::min({tri.v[0].position[2], tri.v[1].position[2], tri.v[2].position[2]});
+
+            bool isBinned = false;
+
+            for (int tileY = (triRect.top() / int(TILE_SIZE)); tileY <= (triRect.bottom() / int(TILE_SIZE)); tileY++)
+            {
+                for (int tileX = (triRect.left() / int(TILE_SIZE)); tileX <= (triRect.right() / int(TILE_SIZE)); tileX++)
                 {
-                    continue;
+                    if (occluders)
+                    {
+                        const vond::rect<int> tileRect = {{int(tileX * TILE_SIZE), int(tileY * TILE_SIZE)},
+                                                          {int(tileX * TILE_SIZE + TILE_SIZE - 1), int(tileY * TILE_SIZE + TILE_SIZE - 1)}};
+
+                        if (occluders->is_occluded(triRect.clipped_against(tileRect), nearestDepth))
+                        {
+                            continue;
+                        }
+                    }
+
+                    tileBins[tileX + tileY * numTilesX].push_back(i);
+                    isBinned = true;
                 }
             }
 
-            tri.v[0].position[2] = vertDepths[0];
-            tri.v[1].position[2] = vertDepths[1];
-            tri.v[2].position[2] = vertDepths[2];
+            if (!isBinned)
+            {
+                counts.numOccluded++;
+                continue;
+            }
 
-            transformedTris.push_back(tri);
+            switch (rasterizers[i])
+            {
+                case rasterizer_e::point: counts.numPoint++; break;
+                case rasterizer_e::barycentric: counts.numBarycentric++; break;
+                case rasterizer_e::half_space: counts.numHalfSpace++; break;
+                case rasterizer_e::scanline: counts.numScanline++; break;
+            }
         }
     }
 
-    return transformedTris;
-}
+    unsigned numPixelsDrawn = 0;
+    unsigned numPixelsCovered = 0;
 
-void vond::render_triangles(const std::vector<vond::triangle> &triangles,
-                            vond::image<uint8_t, 4> &dstPixelmap,
-                            vond::image<double, 1> &dstDepthmap,
-                            const vond::camera &camera)
-{
-    const auto transformedTriangles = transform_triangles(triangles, dstPixelmap.width(), dstPixelmap.height(), camera);
+    if (stats)
+    {
+        BUFFERS.initialTileDepths.resize(tileBins.size() * TILE_SIZE * TILE_SIZE);
+    }
 
-    for (const auto &tri: transformedTriangles)
+    // Rasterize the tiles in parallel. Since each tile's pixels are drawn by only
+    // one thread, the threads needn't synchronize.
+    #pragma omp parallel for schedule(dynamic) reduction(+:numPixelsDrawn, numPixelsCovered)
+    for (unsigned tileIdx = 0; tileIdx < tileBins.size(); tileIdx++)
     {
-        vond::rasterize_triangle::barycentric(tri, dstPixelmap, dstDepthmap);
-        //vond::rasterize_triangle::scanline(tri, dstPixelmap, dstDepthmap);
+        const int tileX = ((tileIdx % numTilesX) * TILE_SIZE);
+        const int tileY = ((tileIdx / numTilesX) * TILE_SIZE);
+        const vond::rect<int> tileRect = {{tileX, tileY},
+                                          {std::min(int(tileX + TILE_SIZE - 1), int(dstPixelmap.width() - 1)),
+                                           std::min(int(tileY + TILE_SIZE - 1), int(dstPixelmap.height() - 1))}};
+
+        if (tileBins[tileIdx].empty())
+        {
+            continue;
+        }
+
+        // For the stats, the tile's depths before drawing, to find how many of its
+        // pixels the triangles covered.
+        const vond::image_view<double, 1> tileDepths = dstDepthmap.view(tileX, tileY, (tileRect.width() + 1), (tileRect.height() + 1));
+        double *const initialDepths = (stats? &BUFFERS.initialTileDepths[tileIdx * TILE_SIZE * TILE_SIZE] : nullptr);
+        if (stats)
+        {
+            for (unsigned y = 0; y < tileDepths.height(); y++)
+            {
+                std::copy_n(&tileDepths.row(y)->channel[0], tileDepths.width(), &initialDepths[y * TILE_SIZE]);
+            }
+        }
+
+        for (const unsigned triIdx: tileBins[tileIdx])
+        {
+            const vond::triangle &tri = transformedTriangles[triIdx];
+            const vond::triangle_material &material = *BUFFERS.materials[triIdx];
+
+            switch (rasterizers[triIdx])
+            {
+                case rasterizer_e::point: numPixelsDrawn += vond::rasterize_triangle::point(tri, material, dstPixelmap, dstDepthmap, tileRect); break;
+                case rasterizer_e::barycentric: numPixelsDrawn += vond::rasterize_triangle::barycentric(tri, material, dstPixelmap, dstDepthmap, tileRect); break;
+                case rasterizer_e::half_space: numPixelsDrawn += vond::rasterize_triangle::half_space(tri, material, dstPixelmap, dstDepthmap, tileRect); break;
+                case rasterizer_e::scanline: numPixelsDrawn += vond::rasterize_triangle::scanline(tri, material, dstPixelmap, dstDepthmap, tileRect); break;
+            }
+        }
+
+        if (stats)
+        {
+            for (unsigned y = 0; y < tileDepths.height(); y++)
+            {
+                for (unsigned x = 0; x < tileDepths.width(); x++)
+                {
+                    numPixelsCovered += (tileDepths.pixel_at(x, y)[0] != initialDepths[(y * TILE_SIZE) + x]);
+                }
+            }
+        }
+    }
+
+    if (stats)
+    {
+        counts.numPixelsDrawn = numPixelsDrawn;
+        counts.numPixelsCovered = numPixelsCovered;
+
+        *stats = counts;
     }
 
     return;
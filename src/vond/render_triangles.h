@@ -12,14 +12,77 @@
 #include "vond/vector.h"
 #include "vond/vertex.h"
 #include "vond/triangle.h"
+#include "vond/mesh.h"
+#include "vond/mesh_instance.h"
 #include "vond/camera.h"
+#include "vond/depth_pyramid.h"
+#include "vond/frustum.h"
 
 namespace vond
 {
-    void render_triangles(const std::vector<vond::triangle> &triangles,
+    // The number of triangles that render_triangles() routed to each rasterizer
+    // on its most recent call, the number it rejected as occluded, and the number
+    // of mesh instances it culled as out of view.
+    //
+    // Also the number of pixels the rasterizers drew, counting each time a pixel
+    // is overwritten, and the number of distinct pixels they drew; the ratio of
+    // the two is the overdraw.
+    struct triangle_raster_stats
+    {
+        unsigned numPoint = 0;
+        unsigned numBarycentric = 0;
+        unsigned numHalfSpace = 0;
+        unsigned numScanline = 0;
+        unsigned numOccluded = 0;
+        unsigned numCulledInstances = 0;
+        unsigned numPixelsDrawn = 0;
+        unsigned numPixelsCovered = 0;
+    };
+
+    // The rasterizers that render_triangles() can draw triangles with. By default,
+    // each triangle is drawn with whichever of the point, half-space and scanline
+    // rasterizers is cheapest for its size on screen; the others force a single
+    // rasterizer for all triangles, e.g. for comparing them.
+    enum class triangle_rasterizer_e
+    {
+        automatic,
+        barycentric,
+        half_space,
+        scanline
+    };
+
+    // Returns the view frustum of the given camera as render_triangles() sees it
+    // on a screen of the given resolution; e.g. for finding the potentially visible
+    // instances in a large scene before passing them to render_triangles().
+    vond::frustum camera_frustum(const vond::camera &camera,
+                                 const unsigned screenWidth,
+                                 const unsigned screenHeight);
+
+    // Transforms the triangles of the given mesh instances into screen space and
+    // rasterizes them, each with the rasterizer that's cheapest for its size on
+    // screen. Instances whose bounding sphere is outside the camera's view are
+    // culled before any of their vertices are transformed.
+    //
+    // If a depth pyramid of what's already in the depth map is given, triangles
+    // (or the parts of them in a given screen tile) that it shows to be hidden are
+    // rejected without being rasterized. If a stats struct is given, it receives
+    // the counts of triangles per rasterizer.
+    //
+    // Triangles are drawn in the order they're in their meshes, unless sorting is
+    // asked for, in which case they're drawn coarsely front to back and, at like
+    // depths, grouped by texture; which reduces overdraw at the cost of the sort.
+    //
+    // All triangles are drawn with the given rasterizer, unless it's automatic.
+    //
+    // Keeps its working memory from call to call, so isn't reentrant.
+    void render_triangles(const std::vector<const vond::mesh_instance*> &instances,
                           vond::image<uint8_t, 4> &dstPixelmap,
                           vond::image<double, 1> &dstDepthmap,
-                          const vond::camera &camera);
+                          const vond::camera &camera,
+                          const vond::depth_pyramid *const occluders = nullptr,
+                          vond::triangle_raster_stats *const stats = nullptr,
+                          const bool isSortedFrontToBack = false,
+                          const vond::triangle_rasterizer_e rasterizer = vond::triangle_rasterizer_e::automatic);
 }
 
 #endif
@@ -0,0 +1,160 @@
+/*
+ * 2021 Tarpeeksi Hyvae Soft
+ *
+ * Software: Vond
+ *
+ * Bakes lighting data out of a heightmap, and lights landscape textures with it.
+ *
+ */
+
+#include <cmath>
+#include <algorithm>
+#include "vond/terrain_lighting.h"
+#include "vond/assert.h"
+
+// The proportions of ambient light and direct sunlight in the lit terrain.
+static const double AMBIENT_LIGHT = 0.45;
+static const double SUN_LIGHT = 0.75;
+
+void vond::bake_terrain_lighting(const vond::image<double, 1> &heightmap,
+                                 vond::image<uint8_t, 4> &dstLightingMap,
+                                 const vond::terrain_lighting_params &params)
+{
+    vond_assert((dstLightingMap.width() == heightmap.width()) &&
+                (dstLightingMap.height() == heightmap.height()),
+                "The lighting map must have the same resolution as the heightmap.");
+
+    vond_assert((params.aoNumDirections > 0), "Ambient occlusion needs at least one search direction.");
+
+    #pragma omp parallel for
+    for (unsigned y = 0; y < heightmap.height(); y++)
+    {
+        for (unsigned x = 0; x < heightmap.width(); x++)
+        {
+            vond::color_rgba<uint8_t> &texel = dstLightingMap.pixel_at<vond::image_bounds_checking_mode_e::none>(x, y);
+
+            // Surface normal, from central differences of the terrain's height.
+            {
+                const double dx = (((heightmap.pixel_at((int(x) + 1), y)[0] - heightmap.pixel_at((int(x) - 1), y)[0]) * params.heightScale) / 2);
+                const double dy = (((heightmap.pixel_at(x, (int(y) + 1))[0] - heightmap.pixel_at(x, (int(y) - 1))[0]) * params.heightScale) / 2);
+                const vond::vector3<double> normal = vond::vector3<double>{-dx, 1, -dy}.normalized();
+
+                for (unsigned i = 0; i < 3; i++)
+                {
+                    texel.channel_at(i) = uint8_t(round((normal[i] * 0.5 + 0.5) * 255));
+                }
+            }
+
+            // Ambient occlusion, from how far the terrain around the texel rises
+            // above it.
+            {
+                const double originHeight = (heightmap.pixel_at<vond::image_bounds_checking_mode_e::none>(x, y)[0] * params.heightScale);
+                double occlusion = 0;
+
+                for (unsigned d = 0; d < params.aoNumDirections; d++)
+                {
+                    const double azimuth = (d * ((2 * M_PI) / params.aoNumDirections));
+                    const double dirX = cos(azimuth);
+                    const double dirY = sin(azimuth);
+                    double maxSlope = 0;
+
+                    for (unsigned t = 1; t <= params.aoSearchDistance; t++)
+                    {
+                        const double height = (heightmap.pixel_at(round(x + (dirX * t)), round(y + (dirY * t)))[0] * params.heightScale);
+
+                        maxSlope = std::max(maxSlope, ((height - originHeight) / t));
+                    }
+
+                    occlusion += sin(atan(maxSlope));
+                }
+
+                texel.channel_at(3) = uint8_t(round((1 - (occlusion / params.aoNumDirections)) * 255));
+            }
+        }
+    }
+
+    return;
+}
+
+// Returns the lit color of the given texture at the given XZ position, with the
+// texture and lighting map's coordinates bounds-checked in the given mode.
+template <vond::image_bounds_checking_mode_e BoundsCheckingMode>
+static vond::color_rgba<uint8_t> lit_texel(const vond::image<uint8_t, 4> &texture,
+                                           const vond::image<uint8_t, 4> &lightingMap,
+                                           const vond::vector3<double> &sunDir,
+                                           const vond::horizon_map *const horizons,
+                                           const double x,
+                                           const double z)
+{
+    // Going through 64 bits lets the fixed-point coordinates wrap around rather
+    // than overflow far from the origin, which doesn't affect mask-wrapping.
+    vond::color_rgba<uint8_t> color = texture.bilinear_sample_fixed<BoundsCheckingMode>(int32_t(int64_t(x * 65536)),
+                                                                                         int32_t(int64_t(z * 65536)));
+
+    // Light the texel. The baked lighting map provides the surface normal and
+    // ambient occlusion in a single fetch.
+    {
+        const vond::color_rgba<uint8_t> &lighting = lightingMap.pixel_at<BoundsCheckingMode>(int(std::floor(x)), int(std::floor(z)));
+        const vond::vector3<double> normal = {((lighting[0] / 127.5) - 1),
+                                              ((lighting[1] / 127.5) - 1),
+                                              ((lighting[2] / 127.5) - 1)};
+
+        double sunVisibility = 1;
+        if (horizons)
+        {
+            const auto [horizonX, horizonZ] = lightingMap.bounds_checked_coordinates<BoundsCheckingMode>(x, z);
+            sunVisibility = horizons->sun_visibility(horizonX, horizonZ);
+        }
+
+        const double ambient = (AMBIENT_LIGHT * (lighting[3] / 255.0));
+        const double diffuse = (SUN_LIGHT * sunVisibility * std::max(0.0, normal.dot(sunDir)));
+        const double shade = (ambient + diffuse);
+
+        for (unsigned i = 0; i < 3; i++)
+        {
+            color.channel_at(i) = uint8_t(std::min(255.0, (color[i] * shade)));
+        }
+    }
+
+    return color;
+}
+
+std::function<vond::color_rgba<uint8_t>(const vond::vector3<double> &samplePosition, const vond::vector3<double> &viewerPosition)>
+    vond::lit_texture_sampler(const vond::image<uint8_t, 4> &texture,
+                              const vond::image<uint8_t, 4> &lightingMap,
+                              const vond::vector3<double> &sunDirection,
+                              const vond::horizon_map *const horizons,
+                              const bool isTiled)
+{
+    const vond::vector3<double> sunDir = sunDirection.normalized();
+
+    if (isTiled)
+    {
+        vond_assert((texture.is_pow2() && lightingMap.is_pow2()),
+                    "A tiling terrain's texture and lighting map must have power-of-two dimensions.");
+
+        return [&texture, &lightingMap, sunDir, horizons]
+               (const vond::vector3<double> &samplePosition, const vond::vector3<double> &viewerPosition)->vond::color_rgba<uint8_t>
+        {
+            (void)viewerPosition;
+
+            return lit_texel<vond::image_bounds_checking_mode_e::wrapped_pow2>(texture, lightingMap, sunDir, horizons,
+                                                                              samplePosition[0], samplePosition[2]);
+        };
+    }
+
+    return [&texture, &lightingMap, sunDir, horizons]
+           (const vond::vector3<double> &samplePosition, const vond::vector3<double> &viewerPosition)->vond::color_rgba<uint8_t>
+    {
+        (void)viewerPosition;
+
+        if ((samplePosition[0] < 0) || (samplePosition[0] > texture.width()) ||
+            (samplePosition[2] < 0) || (samplePosition[2] > texture.height()))
+        {
+            return {0, 0, 0, 0};
+        }
+
+        return lit_texel<vond::image_bounds_checking_mode_e::clamped>(texture, lightingMap, sunDir, horizons,
+                                                                     samplePosition[0], samplePosition[2]);
+    };
+}
@@ -0,0 +1,59 @@
+/*
+ * 2021 Tarpeeksi Hyvae Soft
+ *
+ * Software: Vond
+ *
+ */
+
+#ifndef VOND_TERRAIN_LIGHTING_H
+#define VOND_TERRAIN_LIGHTING_H
+
+#include <functional>
+#include "vond/image.h"
+#include "vond/color.h"
+#include "vond/vector.h"
+#include "vond/horizon_map.h"
+
+namespace vond
+{
+    // Parameters for bake_terrain_lighting().
+    struct terrain_lighting_params
+    {
+        // The number of directions, and the distance in texels along each, over
+        // which the terrain is searched for occluders when baking ambient occlusion.
+        unsigned aoNumDirections = 8;
+        unsigned aoSearchDistance = 16;
+
+        // The factor by which the heightmap's values are multiplied to get heights
+        // in the same units as the distance between adjacent texels.
+        double heightScale = 1;
+    };
+
+    // Derives from the given heightmap a per-texel map of surface normals and
+    // ambient occlusion, and writes it into the given lighting map, which must be
+    // of the heightmap's resolution. The normals are stored in the RGB channels
+    // (each component mapped from [-1, 1] to [0, 255]) and the ambient occlusion in
+    // the alpha channel (0 = fully occluded, 255 = unoccluded). Terrain past the
+    // heightmap's edges is read in the heightmap's bounds-checking mode, so for a
+    // tiling terrain, the heightmap should be set to wrap.
+    void bake_terrain_lighting(const vond::image<double, 1> &heightmap,
+                               vond::image<uint8_t, 4> &dstLightingMap,
+                               const vond::terrain_lighting_params &params = {});
+
+    // Returns a texture sampler for render_landscape() that samples the given ground
+    // texture and lights it with the given baked lighting map (see
+    // bake_terrain_lighting()) and a sun in the given direction. If a horizon map is
+    // given, terrain that the sun doesn't reach will also be shadowed.
+    //
+    // If the terrain is tiled, the texture and lighting map repeat infinitely in
+    // every direction; their dimensions must then be powers of two. Otherwise,
+    // positions outside of the texture sample as transparent.
+    std::function<vond::color_rgba<uint8_t>(const vond::vector3<double> &samplePosition, const vond::vector3<double> &viewerPosition)>
+        lit_texture_sampler(const vond::image<uint8_t, 4> &texture,
+                            const vond::image<uint8_t, 4> &lightingMap,
+                            const vond::vector3<double> &sunDirection,
+                            const vond::horizon_map *const horizons = nullptr,
+                            const bool isTiled = false);
+}
+
+#endif
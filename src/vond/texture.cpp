@@ -0,0 +1,114 @@
+/*
+ * 2021 Tarpeeksi Hyvae Soft
+ *
+ * Software: Vond
+ *
+ * Builds a texture's mip chain.
+ *
+ */
+
+#include <iterator>
+#include "vond/texture.h"
+#include "vond/assert.h"
+
+vond::texture::texture(const QImage &qImage, const vond::texture_layout_e layout) :
+    layout_(layout)
+{
+    // The levels are first built in the linear layout, each from the previous one.
+    {
+        const vond::image<uint8_t, 4> image(qImage);
+
+        level_s level0 = {image.width(), image.height(), 0, {}};
+        level0.texels.resize(image.width() * image.height());
+
+        for (unsigned y = 0; y < image.height(); y++)
+        {
+            for (unsigned x = 0; x < image.width(); x++)
+            {
+                level0.texels[x + (y * image.width())] = image.pixel_at(x, y);
+            }
+        }
+
+        this->levels.push_back(std::move(level0));
+    }
+
+    // Each level is a 2 x 2 box-filtered version of the previous one. The chain
+    // stops before either dimension falls below two texels, as the bilinear
+    // sampler needs a pair of texels to filter between.
+    while ((this->levels.back().width >= 4) &&
+           (this->levels.back().height >= 4))
+    {
+        const level_s &src = this->levels.back();
+        level_s dst = {(src.width / 2), (src.height / 2), 0, {}};
+        dst.texels.resize(dst.width * dst.height);
+
+        for (unsigned y = 0; y < dst.height; y++)
+        {
+            for (unsigned x = 0; x < dst.width; x++)
+            {
+                const vond::color_rgba<uint8_t> &p1 = src.texels[(x * 2)       + ((y * 2)       * src.width)];
+                const vond::color_rgba<uint8_t> &p2 = src.texels[((x * 2) + 1) + ((y * 2)       * src.width)];
+                const vond::color_rgba<uint8_t> &p3 = src.texels[(x * 2)       + (((y * 2) + 1) * src.width)];
+                const vond::color_rgba<uint8_t> &p4 = src.texels[((x * 2) + 1) + (((y * 2) + 1) * src.width)];
+
+                for (unsigned i = 0; i < 4; i++)
+                {
+                    dst.texels[x + (y * dst.width)].channel_at(i) = ((p1[i] + p2[i] + p3[i] + p4[i] + 2) / 4);
+                }
+            }
+        }
+
+        this->levels.push_back(std::move(dst));
+    }
+
+    // Reorder the texels into tiles. Texels in the padding past the level's right
+    // and bottom edges are never sampled.
+    if (this->layout_ == vond::texture_layout_e::tiled)
+    {
+        for (level_s &level: this->levels)
+        {
+            level.tilesPerRow = ((level.width + 3) / 4);
+
+            const unsigned tilesPerColumn = ((level.height + 3) / 4);
+            std::vector<vond::color_rgba<uint8_t>> tiled(level.tilesPerRow * tilesPerColumn * 16);
+
+            for (unsigned y = 0; y < level.height; y++)
+            {
+                for (unsigned x = 0; x < level.width; x++)
+                {
+                    const unsigned tileIdx = ((y / 4) * level.tilesPerRow) + (x / 4);
+                    tiled[(tileIdx * 16) + ((y % 4) * 4) + (x % 4)] = level.texels[x + (y * level.width)];
+                }
+            }
+
+            // The tiled layout must sample identically to the linear one. The
+            // filter weights don't depend on the layout, so it suffices that
+            // every 2 x 2 block of texels that sample() can filter between is
+            // addressed to the same texels in both.
+            for (unsigned y = 0; y < (level.height - 1); y++)
+            {
+                for (unsigned x = 0; x < (level.width - 1); x++)
+                {
+                    unsigned idx[4];
+                    this->texel_indices(level, x, y, idx);
+
+                    const unsigned linearIdx[4] = {(x + (y * level.width)),
+                                                   (x + (y * level.width) + 1),
+                                                   (x + ((y + 1) * level.width)),
+                                                   (x + ((y + 1) * level.width) + 1)};
+
+                    for (unsigned i = 0; i < 4; i++)
+                    {
+                        vond_assert(std::equal(std::begin(tiled[idx[i]].channel), std::end(tiled[idx[i]].channel),
+                                               std::begin(level.texels[linearIdx[i]].channel)),
+                                    "The tiled texture layout doesn't sample identically to the linear one.");
+                    }
+                }
+            }
+
+            level.texels = std::move(tiled);
+        }
+    }
+
+    return;
+}
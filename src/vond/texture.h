@@ -0,0 +1,156 @@
+/*
+ * 2021 Tarpeeksi Hyvae Soft
+ *
+ * Software: Vond
+ *
+ */
+
+#ifndef VOND_TEXTURE_H
+#define VOND_TEXTURE_H
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "vond/image.h"
+#include "vond/color.h"
+
+namespace vond
+{
+    // How a texture's texels are ordered in memory.
+    enum class texture_layout_e
+    {
+        // Row by row, as in vond::image.
+        linear,
+
+        // In tiles of 4 x 4 texels, each tile's texels stored together and the
+        // tiles row by row. A pixel's bilinear sample then usually reads from a
+        // single tile, and the samples of neighboring pixels from the same few
+        // cache lines whichever direction the texture is traversed on screen.
+        // Addressing the texels costs a bit more, so this is slower than the
+        // linear layout where the texture's rows run across the screen, but
+        // faster where they run down it.
+        tiled,
+    };
+
+    // A triangle texture: an RGBA image and its mip chain - successively half-size
+    // versions of it - so that where the texture is minified on screen, it can be
+    // sampled from a level whose texels are about the size of a pixel. This avoids
+    // aliasing, and keeps neighboring pixels' samples in nearby memory.
+    class texture
+    {
+    public:
+        texture(const QImage &qImage, const vond::texture_layout_e layout = vond::texture_layout_e::linear);
+
+        // The resolution of the full-size texture, i.e. of mip level 0.
+        unsigned width(void) const
+        {
+            return this->levels[0].width;
+        }
+
+        unsigned height(void) const
+        {
+            return this->levels[0].height;
+        }
+
+        unsigned num_levels(void) const
+        {
+            return this->levels.size();
+        }
+
+        vond::texture_layout_e layout(void) const
+        {
+            return this->layout_;
+        }
+
+        // Returns the mip level to sample where the texture coordinates change by
+        // the given amounts (in u,v units, i.e. 0 to 1 across the texture) from one
+        // pixel to the next horizontally (dudx, dvdx) and vertically (dudy, dvdy).
+        unsigned level_for(const double dudx, const double dvdx, const double dudy, const double dvdy) const
+        {
+            const double w = this->width();
+            const double h = this->height();
+
+            // The squared number of texels of level 0 that a pixel spans.
+            const double footprintSq = std::max((((dudx * w) * (dudx * w)) + ((dvdx * h) * (dvdx * h))),
+                                                (((dudy * w) * (dudy * w)) + ((dvdy * h) * (dvdy * h))));
+
+            if (footprintSq <= 1)
+            {
+                return 0;
+            }
+
+            // The level whose texels are nearest in size to a pixel: log2 of the
+            // footprint, rounded.
+            return std::min((this->num_levels() - 1), unsigned((0.5 * std::log2(footprintSq)) + 0.5));
+        }
+
+        // Returns the texture's bilinearly filtered color at the given u,v
+        // coordinates in the given mip level. Coordinates outside of 0..1 are
+        // clamped to the texture's edges.
+        vond::color_rgba<uint8_t> sample(const double u, const double v, const unsigned levelIdx) const
+        {
+            const level_s &level = this->levels[levelIdx];
+
+            // The rasterizers call this for every pixel, so the texels are filtered
+            // in 16.16 fixed point by the sampler that vond::image::bilinear_sample_fixed()
+            // also uses.
+            return vond::bilinear_sample_fixed_clamped(level.texels.data(), level.width, level.height,
+                                                       int32_t(int64_t(u * level.width * 65536)),
+                                                       int32_t(int64_t(v * level.height * 65536)),
+                                                       [this, &level](const unsigned x, const unsigned y, unsigned idx[4])
+                                                       {
+                                                           this->texel_indices(level, x, y, idx);
+                                                       });
+        }
+
+    private:
+        struct level_s
+        {
+            unsigned width;
+            unsigned height;
+
+            // For the tiled layout, the number of tiles on each row of tiles. The
+            // level's texel array is padded to a whole number of tiles.
+            unsigned tilesPerRow;
+
+            std::vector<vond::color_rgba<uint8_t>> texels;
+        };
+
+        // Fills in the indices in the given level's texel array of the 2 x 2
+        // texels whose top left texel is at x,y: top left, top right, bottom left
+        // and bottom right.
+        void texel_indices(const level_s &level, const unsigned x, const unsigned y, unsigned idx[4]) const
+        {
+            if (this->layout_ == vond::texture_layout_e::tiled)
+            {
+                const unsigned topLeft = ((((y / 4) * level.tilesPerRow) + (x / 4)) * 16) + ((y % 4) * 4) + (x % 4);
+
+                // Unless the texels straddle a tile's edge, they're all in the
+                // same tile.
+                const unsigned xStep = (((x % 4) == 3)? 13 : 1);
+                const unsigned yStep = (((y % 4) == 3)? ((level.tilesPerRow * 16) - 12) : 4);
+
+                idx[0] = topLeft;
+                idx[1] = (topLeft + xStep);
+                idx[2] = (topLeft + yStep);
+                idx[3] = (topLeft + xStep + yStep);
+            }
+            else
+            {
+                idx[0] = (x + (y * level.width));
+                idx[1] = (idx[0] + 1);
+                idx[2] = (idx[0] + level.width);
+                idx[3] = (idx[2] + 1);
+            }
+
+            return;
+        }
+
+        const vond::texture_layout_e layout_;
+
+        // The mip levels, from the full-size image down.
+        std::vector<level_s> levels;
+    };
+}
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <string>
 #include "vond/image.h"
+#include "vond/texture.h"
 #include "vond/vertex.h"
 
 namespace vond
@@ -11,13 +12,14 @@ namespace vond
     {
         std::string name = "Unnamed material";
         vond::color<uint8_t, 4> baseColor = {0};
-        vond::image<uint8_t, 4> *texture = nullptr;
+        vond::texture *texture = nullptr;
     };
 
+    // A triangle's material is kept by its mesh (see vond::mesh::materials), so
+    // the triangle itself is only its vertices.
     struct triangle
     {
         vond::vertex v[3];
-        vond::triangle_material material;
     };
 }
 
@@ -15,13 +15,27 @@ SOURCES += src/auxiliary/main.cpp \
     src/auxiliary/display/qt/window.cpp \
     src/vond/rasterize_triangle_barycentric.cpp \
     src/vond/rasterize_triangle_scanline.cpp \
+    src/vond/rasterize_triangle_half_space.cpp \
+    src/vond/rasterize_triangle_point.cpp \
     src/vond/render_landscape.cpp \
+    src/vond/horizon_map.cpp \
+    src/vond/terrain_lighting.cpp \
+    src/vond/landscape_impostor.cpp \
+    src/vond/fog.cpp \
+    src/vond/depth_pyramid.cpp \
+    src/vond/frustum.cpp \
+    src/vond/instance_quadtree.cpp \
+    src/vond/mesh_simplify.cpp \
+    src/vond/texture.cpp \
+    src/vond/image_buffer_pool.cpp \
     src/auxiliary/display/qt/w_opengl.cpp \
     src/auxiliary/ui/text.cpp \
     src/auxiliary/ui/input.cpp \
     src/vond/render_triangles.cpp \
     src/auxiliary/data_access/mesh_file.cpp \
-    src/auxiliary/data_access/config_file_read.cpp
+    src/auxiliary/data_access/config_file_read.cpp \
+    src/auxiliary/data_access/lighting_file.cpp \
+    src/auxiliary/data_access/mesh_lod_file.cpp
 
 HEADERS += \
     src/auxiliary/display.h \
@@ -33,9 +47,24 @@ HEADERS += \
     src/vond/image_mosaic.h \
     src/vond/rasterize_triangle_barycentric.h \
     src/vond/rasterize_triangle_scanline.h \
+    src/vond/rasterize_triangle_half_space.h \
+    src/vond/rasterize_triangle_point.h \
     src/vond/ray.h \
     src/vond/rect.h \
     src/vond/render_landscape.h \
+    src/vond/horizon_map.h \
+    src/vond/terrain_lighting.h \
+    src/vond/landscape_impostor.h \
+    src/vond/fog.h \
+    src/vond/depth_pyramid.h \
+    src/vond/mesh.h \
+    src/vond/mesh_instance.h \
+    src/vond/frustum.h \
+    src/vond/instance_quadtree.h \
+    src/vond/mesh_simplify.h \
+    src/vond/texture.h \
+    src/vond/image_buffer_pool.h \
+    src/vond/image_view.h \
     src/vond/image.h \
     src/vond/matrix.h \
     src/auxiliary/display/qt/w_opengl.h \
@@ -46,6 +75,8 @@ HEADERS += \
     src/auxiliary/ui/input.h \
     src/vond/render_triangles.h \
     src/auxiliary/data_access/mesh_file.h \
+    src/auxiliary/data_access/lighting_file.h \
+    src/auxiliary/data_access/mesh_lod_file.h \
     src/auxiliary/config_file_read.h \
     src/vond/vertex.h
 